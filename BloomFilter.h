@@ -0,0 +1,88 @@
+// Jong Hoon Kim
+// CS32 - Project 4
+
+#ifndef BLOOMFILTER_INCLUDED
+#define BLOOMFILTER_INCLUDED
+
+#include <cstdint>
+#include <cmath>
+#include <vector>
+
+
+class BloomFilter
+{
+public:
+    // Constructors
+    //
+    // Pre-condition: N/A
+    // Post-condition: Create a filter without any bits. it may contain every key
+    BloomFilter() : m_numBits(0), m_numHashes(0) { }
+    //
+    // Pre-condition: expected number of keys, false positive rate between 0 and 1, and the
+    //                maximum size of the bit array in bytes (0 for no limit)
+    // Post-condition: Create an empty filter with the number of bits and hash functions that
+    //                 give the rate for the expected keys, shrunk to the size limit if needed
+    BloomFilter(size_t expectedKeys, double falsePositiveRate, size_t maxBytes)
+    {
+        const double ln2 = std::log(2.0);
+        double bits = -(double)(expectedKeys) * std::log(falsePositiveRate) / (ln2 * ln2);
+        if (maxBytes > 0 && bits > 8.0 * maxBytes) bits = 8.0 * maxBytes;
+        m_numBits = bits < 64 ? 64 : static_cast<uint64_t>(bits);
+        int hashes = static_cast<int>(std::round((double)(m_numBits) / (expectedKeys ? expectedKeys : 1) * ln2));
+        m_numHashes = hashes < 1 ? 1 : (hashes > 16 ? 16 : hashes);
+        m_bits.assign((m_numBits + 63) / 64, 0);
+    }
+
+    // Mutator Function
+    //
+    // Pre-condition: key (an encoded k-mer)
+    // Post-condition: set the key's bits
+    void insert(uint64_t key)
+    {
+        uint64_t h1 = mix(key), h2 = mix(h1) | 1;
+        for (int i = 0; i < m_numHashes; ++i, h1 += h2) {
+            uint64_t bit = h1 % m_numBits;
+            m_bits[bit >> 6] |= uint64_t(1) << (bit & 63);
+        }
+    }
+
+    // Accessor Functions
+    //
+    // Pre-condition: key (an encoded k-mer)
+    // Post-condition: returns false only if the key was never inserted
+    bool mayContain(uint64_t key) const
+    {
+        if (m_numBits == 0) return true;
+        uint64_t h1 = mix(key), h2 = mix(h1) | 1;
+        for (int i = 0; i < m_numHashes; ++i, h1 += h2) {
+            uint64_t bit = h1 % m_numBits;
+            if (!(m_bits[bit >> 6] & (uint64_t(1) << (bit & 63)))) return false;
+        }
+        return true;
+    }
+    //
+    // Pre-condition: N/A
+    // Post-condition: returns the size of the bit array in bytes
+    size_t bytes() const { return m_bits.size() * sizeof(uint64_t); }
+
+private:
+    std::vector<uint64_t> m_bits;
+    uint64_t m_numBits;
+    int m_numHashes;
+
+    // helper function
+    //
+    // Pre-condition: key
+    // Post-condition: returns a well mixed hash of the key (murmur3 finalizer)
+    static uint64_t mix(uint64_t key)
+    {
+        key ^= key >> 33;
+        key *= 0xff51afd7ed558ccdULL;
+        key ^= key >> 33;
+        key *= 0xc4ceb9fe1a85ec53ULL;
+        key ^= key >> 33;
+        return key;
+    }
+};
+
+#endif // BLOOMFILTER_INCLUDED
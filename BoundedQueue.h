@@ -0,0 +1,75 @@
+// Jong Hoon Kim
+// CS32 - Project 4
+
+#ifndef BOUNDEDQUEUE_INCLUDED
+#define BOUNDEDQUEUE_INCLUDED
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <cstddef>
+
+
+template<typename ItemType>
+class BoundedQueue
+{
+public:
+    // Constructor
+    //
+    // Pre-condition: maximum number of items the queue holds (at least 1)
+    // Post-condition: Create an empty, open queue
+    explicit BoundedQueue(size_t capacity) : m_capacity(capacity > 0 ? capacity : 1), m_closed(false) { }
+
+    // Mutator Functions
+    //
+    // Pre-condition: item to add
+    // Post-condition: wait until there is room and add the item to the back. returns false,
+    //                 without adding it, if the queue is closed
+    bool push(ItemType item)
+    {
+        std::unique_lock<std::mutex> lock(m_lock);
+        m_notFull.wait(lock, [this] { return m_closed || m_items.size() < m_capacity; });
+        if (m_closed) return false;
+        m_items.push_back(std::move(item));
+        m_notEmpty.notify_one();
+        return true;
+    }
+    //
+    // Pre-condition: variable to store the item
+    // Post-condition: wait until there is an item and move the front one into the variable.
+    //                 returns false once the queue is closed and empty
+    bool pop(ItemType& item)
+    {
+        std::unique_lock<std::mutex> lock(m_lock);
+        m_notEmpty.wait(lock, [this] { return m_closed || !m_items.empty(); });
+        if (m_items.empty()) return false;
+        item = std::move(m_items.front());
+        m_items.pop_front();
+        m_notFull.notify_one();
+        return true;
+    }
+    //
+    // Pre-condition: N/A
+    // Post-condition: no more items can be pushed. items already in the queue can still be
+    //                 popped, and every waiting thread wakes up
+    void close()
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        m_closed = true;
+        m_notFull.notify_all();
+        m_notEmpty.notify_all();
+    }
+
+      // C++11 syntax for preventing copying and assignment
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+private:
+    std::deque<ItemType> m_items;
+    size_t m_capacity;
+    bool m_closed;
+    std::mutex m_lock;
+    std::condition_variable m_notFull;
+    std::condition_variable m_notEmpty;
+};
+
+#endif // BOUNDEDQUEUE_INCLUDED
@@ -0,0 +1,116 @@
+// Jong Hoon Kim
+// CS32 - Project 4
+
+#ifndef FASTQREADER_INCLUDED
+#define FASTQREADER_INCLUDED
+
+#include <string>
+#include <cstring>
+#include <zlib.h>
+
+
+class FastqReader
+{
+public:
+    // Constructor
+    //
+    // Pre-condition: Only default constructor can be called
+    // Post-condition: Create a reader with no file open
+    FastqReader() : m_file(nullptr), m_bad(false) { }
+
+    // Destructor
+    //
+    // Pre-condition: N/A
+    // Post-condition: close the file if one is open
+    ~FastqReader() { close(); }
+
+    // Mutator Functions
+    //
+    // Pre-condition: path of a FASTQ file, plain or gzip compressed
+    // Post-condition: open the file and returns false if it can't be opened. zlib reads
+    //                 plain files as they are, so both kinds go through it
+    bool open(const std::string& path)
+    {
+        close();
+        m_bad = false;
+        m_file = gzopen(path.c_str(), "rb");
+        if (m_file == nullptr) return false;
+        gzbuffer(m_file, 1 << 17);
+        return true;
+    }
+    //
+    // Pre-condition: N/A
+    // Post-condition: close the file
+    void close()
+    {
+        if (m_file != nullptr) gzclose(m_file);
+        m_file = nullptr;
+    }
+    //
+    // Pre-condition: strings to store the read name (header without '@' up to the first
+    //                space) and its bases
+    // Post-condition: read the next record into them and returns true. returns false at the
+    //                 end of the file, or when a record is malformed, after which bad() is true
+    bool next(std::string& name, std::string& sequence)
+    {
+        // a record is "@name ...", the bases, "+...", and one quality character per base
+        if (m_file == nullptr) return false;
+        do {
+            if (!readLine(m_header)) return false;
+        } while (m_header.empty());
+        if (m_header[0] != '@' || !readLine(sequence) ||
+            !readLine(m_separator) || m_separator.empty() || m_separator[0] != '+' ||
+            !readLine(m_quality) || m_quality.size() != sequence.size()) {
+            m_bad = true;
+            return false;
+        }
+        size_t end = m_header.find_first_of(" \t");
+        name.assign(m_header, 1, end == std::string::npos ? std::string::npos : end - 1);
+        for (size_t i = 0; i < sequence.size(); ++i)
+            sequence[i] = toUpper(sequence[i]);
+        return true;
+    }
+
+    // Accessor Function
+    //
+    // Pre-condition: N/A
+    // Post-condition: returns true if a malformed record was found
+    bool bad() const { return m_bad; }
+
+      // C++11 syntax for preventing copying and assignment
+    FastqReader(const FastqReader&) = delete;
+    FastqReader& operator=(const FastqReader&) = delete;
+private:
+    gzFile m_file;
+    bool m_bad;
+    std::string m_header;
+    std::string m_separator;
+    std::string m_quality;
+    char m_buffer[4096];
+
+    // helper functions
+    //
+    // Pre-condition: string to store the line
+    // Post-condition: read the next line without its line ending and returns false at the
+    //                 end of the file
+    bool readLine(std::string& line)
+    {
+        line.clear();
+        bool any = false;
+        while (gzgets(m_file, m_buffer, sizeof(m_buffer)) != nullptr) {
+            any = true;
+            size_t length = strlen(m_buffer);
+            line.append(m_buffer, length);
+            if (length > 0 && m_buffer[length - 1] == '\n') break;
+        }
+        while (!line.empty() && (line.back() == '\n' || line.back() == '\r'))
+            line.pop_back();
+        return any;
+    }
+    //
+    // Pre-condition: character
+    // Post-condition: returns the character in upper case
+    static char toUpper(char c) { return (c >= 'a' && c <= 'z') ? static_cast<char>(c - 'a' + 'A') : c; }
+};
+
+#endif // FASTQREADER_INCLUDED
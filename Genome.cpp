@@ -47,49 +47,17 @@ GenomeImpl::GenomeImpl(const string& nm, const string& sequence)
 
 bool GenomeImpl::load(istream& genomeSource, vector<Genome>& genomes) 
 {
-    // initialize variables
+    // read every Genome with a GenomeReader, and store nothing if any of them is malformed
     genomes.clear();
+    GenomeReader reader(genomeSource);
     string newName;
     string newSeq;
-    string temp;
-    int i;
-    char tempChar;
-    bool parsingSeq = false;
-    
-    // while its possible to read in data from input, parse and store Genome data
-    // corresponding to structure of Genome data file
-    while (getline(genomeSource, temp)) {
-        if (temp[0] == '>') {
-            if (parsingSeq && newSeq == "") {
-                genomes.clear();
-                return false;
-            }
-            else {
-                if (parsingSeq) genomes.push_back(Genome(newName, newSeq));
-                newName = temp.substr(1);
-                if (newName == "") {
-                    genomes.clear();
-                    return false;
-                }
-                newSeq = "";
-                parsingSeq = true;
-            }
-        }
-        else {
-            if (!parsingSeq) return false;
-            for (i = 0; i < temp.size(); ++i) {
-                tempChar = toupper(temp[i]);
-                if (tempChar == 'A' || tempChar == 'C' ||
-                    tempChar == 'T' || tempChar == 'G' ||
-                    tempChar == 'N') newSeq += tempChar;
-                else {
-                    genomes.clear();
-                    return false;
-                }
-            }
-        }
+    while (reader.next(newName, newSeq))
+        genomes.push_back(Genome(newName, newSeq));
+    if (reader.bad()) {
+        genomes.clear();
+        return false;
     }
-    if (newSeq != "") genomes.push_back(Genome(newName, newSeq));
     
     // return true is Genome was successfully stored
     return genomes.size() != 0;
@@ -112,6 +80,90 @@ bool GenomeImpl::extract(int position, int length, string& fragment) const
     return true;
 }
 
+class GenomeReaderImpl
+{
+public:
+    // Constructor
+    //
+    // Pre-condition: istream object to read Genome data from
+    // Post-condition: set the source, nothing is read yet
+    GenomeReaderImpl(istream& genomeSource);
+    
+    // Mutator Function
+    //
+    // Pre-condition: strings to store the name and sequence
+    // Post-condition: parse the next Genome of the input into them and returns true. returns
+    //                 false at the end of the input, or if the input is malformed
+    bool next(string& name, string& sequence);
+    
+    // Accessor Function
+    //
+    // Pre-condition: N/A
+    // Post-condition: returns true if the input turned out to be malformed
+    bool bad() const;
+private:
+    istream& m_source;
+    string m_pendingName;   // name from the header line that ended the previous Genome
+    bool m_started;
+    bool m_done;
+    bool m_bad;
+};
+
+GenomeReaderImpl::GenomeReaderImpl(istream& genomeSource)
+                 :m_source(genomeSource), m_started(false), m_done(false), m_bad(false) {}
+
+bool GenomeReaderImpl::next(string& name, string& sequence)
+{
+    if (m_done || m_bad) return false;
+    string temp;
+    
+    // the input has to begin with a header line with a name
+    if (!m_started) {
+        if (!getline(m_source, temp)) {
+            m_done = true;
+            return false;
+        }
+        if (temp[0] != '>' || temp.size() == 1) {
+            m_bad = true;
+            return false;
+        }
+        m_pendingName = temp.substr(1);
+        m_started = true;
+    }
+    
+    // collect sequence lines up to the next header line, whose name is kept for the next
+    // call. a header needs a name and every Genome at least one base
+    name = m_pendingName;
+    sequence.clear();
+    while (getline(m_source, temp)) {
+        if (temp[0] == '>') {
+            if (sequence.empty() || temp.size() == 1) {
+                m_bad = true;
+                return false;
+            }
+            m_pendingName = temp.substr(1);
+            return true;
+        }
+        for (size_t i = 0; i < temp.size(); ++i) {
+            char tempChar = toupper(temp[i]);
+            if (tempChar == 'A' || tempChar == 'C' ||
+                tempChar == 'T' || tempChar == 'G' ||
+                tempChar == 'N') sequence += tempChar;
+            else {
+                m_bad = true;
+                return false;
+            }
+        }
+    }
+    
+    // a last header without any sequence is ignored
+    m_done = true;
+    return !(sequence.empty());
+}
+
+bool GenomeReaderImpl::bad() const
+{ return m_bad; }
+
 //******************** Genome functions ************************************
 
 // These functions simply delegate to GenomeImpl's functions.
@@ -159,3 +211,27 @@ bool Genome::extract(int position, int length, string& fragment) const
 {
     return m_impl->extract(position, length, fragment);
 }
+
+//******************** GenomeReader functions ******************************
+
+// These functions simply delegate to GenomeReaderImpl's functions.
+
+GenomeReader::GenomeReader(istream& genomeSource)
+{
+    m_impl = new GenomeReaderImpl(genomeSource);
+}
+
+GenomeReader::~GenomeReader()
+{
+    delete m_impl;
+}
+
+bool GenomeReader::next(string& name, string& sequence)
+{
+    return m_impl->next(name, sequence);
+}
+
+bool GenomeReader::bad() const
+{
+    return m_impl->bad();
+}
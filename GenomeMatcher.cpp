@@ -3,11 +3,29 @@
 
 #include "provided.h"
 #include "Trie.h"
+#include "Kmer.h"
+#include "KmerTable.h"
+#include "BloomFilter.h"
+#include "SequenceStore.h"
+#include "BoundedQueue.h"
+#include "ReorderWindow.h"
+#include "FastqReader.h"
+#include "LRUCache.h"
 #include <string>
 #include <vector>
 #include <iostream>
 #include <fstream>
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <unistd.h>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <memory>
 #include <unordered_map>
+#include <unordered_set>
 using namespace std;
 
 class GenomeMatcherImpl
@@ -15,16 +33,24 @@ class GenomeMatcherImpl
 public:
     // Constructor
     //
-    // Pre-condition: minimum search length to be passed
-    // Post-condition: set the private data member
-    GenomeMatcherImpl(int minSearchLength);
+    // Pre-condition: minimum search length, kind of index, and index options to be passed
+    // Post-condition: set the private data members. the k-mer hash index needs the minimum
+    //                 search length to fit an encoded key, otherwise the trie is used
+    GenomeMatcherImpl(int minSearchLength, IndexKind index, const IndexOptions& options);
     
     // Mutator Function
     //
     // Pre-condition: a Genome object to add
     // Post-condition: Add the Genome to the vector and insert the sequence into the trie
-    //                 also add the genome name and the position as a string into last node
-    void addGenome(const Genome& genome);
+    //                 also add the genome name and the position as a string into last node.
+    //                 returns false, without adding it, if it can't be written to the
+    //                 storage directory
+    bool addGenome(const Genome& genome);
+    //
+    // Pre-condition: characters to treat as first bases of indexed k-mers
+    // Post-condition: a seed starting with one of them is searched even if no k-mer of this
+    //                 library starts with it, as if another genome had one
+    void addFirstBases(const string& bases);
     
     // Accessor Function
     //
@@ -32,6 +58,23 @@ public:
     // Post-condition: returns the minimum search length
     int minimumSearchLength() const;
     //
+    // Pre-condition: N/A
+    // Post-condition: returns every character an indexed or stop-listed k-mer starts with,
+    //                 and the ones added by addFirstBases
+    string firstBases() const;
+    //
+    // Pre-condition: N/A
+    // Post-condition: returns the kind of index in use
+    IndexKind indexKind() const;
+    //
+    // Pre-condition: N/A
+    // Post-condition: returns the seed counters accumulated by queries so far
+    QueryStats queryStats() const;
+    //
+    // Pre-condition: N/A
+    // Post-condition: set every seed counter to zero
+    void resetQueryStats();
+    //
     // Pre-condition: sequence fragment, minimum length of match, exact match condition boolean,
     //                and DNAMatch vector
     // Post-condition: store satisfied DNAMatch objects into vector and returns true if any
@@ -39,49 +82,384 @@ public:
     bool findGenomesWithThisDNA(const string& fragment, int minimumLength,
                                 bool exactMatchOnly, vector<DNAMatch>& matches) const;
     //
+    // Pre-condition: sequence fragment, minimum length of match, exact match condition boolean,
+    //                callback, and maximum number of matches per genome (0 for no limit)
+    // Post-condition: call callback with every position in every genome where the fragment
+    //                 matches for at least minimum length, in index order, and returns the
+    //                 number of matches reported
+    int enumerateDNAMatches(const string& fragment, int minimumLength, bool exactMatchOnly,
+                            const DNAMatchCallback& callback, int maxMatchesPerGenome) const;
+    //
+    // Pre-condition: sequence fragment, minimum length of match, maximum number of edits,
+    //                indel condition boolean, and DNAMatch vector
+    // Post-condition: store the longest match per genome that covers at least minimum length
+    //                 of the fragment with up to maxEdits substitutions (and insertions or
+    //                 deletions if allowed) into vector and returns true if any is found.
+    //                 returns false if minimum length holds too few seeds to be sure of
+    //                 finding such a match: maxEdits or fewer, or half as many with
+    //                 substitutions only
+    bool findGenomesWithSimilarDNA(const string& fragment, int minimumLength, int maxEdits,
+                                   bool allowIndels, vector<DNAMatch>& matches) const;
+    //
     // Pre-condition: comparing Genome, fragment match length, exact match condition, percent
     //                matching threshold, and a vector to store results
     // Post-condition: store all GenomeMatch object into results if there is any indexed genome
     //                 that matches with query Genome. and returns true if found any matching one
     bool findRelatedGenomes(const Genome& query, int fragmentMatchLength, bool exactMatchOnly,
                             double matchPercentThreshold, vector<GenomeMatch>& results) const;
+    //
+    // Pre-condition: fragment match length, exact match condition, output file name, sparse
+    //                output condition, and progress callback (may be empty)
+    // Post-condition: compute percentMatch of every indexed genome as a query against every
+    //                 indexed genome and write the matrix into the file. returns false if the
+    //                 length is too short or the file can't be written. windows with the same
+    //                 bases are looked up once for every genome they occur in, and the work is
+    //                 spread over threads. progress is called on the calling thread
+    bool computeSimilarityMatrix(int fragmentMatchLength, bool exactMatchOnly,
+                                 const string& outputFile, bool sparse,
+                                 const ProgressCallback& progress) const;
+    //
+    // Pre-condition: comparing Genome, k-mer length (up to MAX_ENCODED_KMER_LENGTH), percent
+    //                containment threshold, and a vector to store results
+    // Post-condition: look up every overlapping k-mer of the query and store the containment
+    //                 and Jaccard score of each indexed genome whose containment reaches the
+    //                 threshold into results. returns true if found any matching one
+    bool findRelatedGenomesByKmers(const Genome& query, int fragmentMatchLength,
+                                   double matchPercentThreshold,
+                                   vector<GenomeSimilarity>& results) const;
+    //
+    // Pre-condition: read sequence and ReadAssignment to store the result
+    // Post-condition: look up every k-mer of minimum search length in the read and assign it
+    //                 to the genome the most of them are found in, the first one added among
+    //                 equals. returns false, with an empty genome name, if none is found
+    bool classifyRead(const string& read, ReadAssignment& assignment) const;
+    //
+    // Pre-condition: FASTQ file (plain or gzip), output file name, long long to store the number
+    //                of reads, and number of worker threads (0 for one per core)
+    // Post-condition: classify every read of the file and write one "read, genome, hits,
+    //                 ambiguous" line per read into the output file in the order of the reads.
+    //                 returns false if a file can't be opened or written or a record is malformed
+    bool classifyReads(const string& readsFile, const string& outputFile,
+                       long long& readsClassified, int numThreads) const;
     
 private:
+    // location of an indexed fragment: index into m_genomeNames/m_sequences and position
+    struct Posting {
+        int genome;
+        int position;
+    };
+    
+    // k-mer containing N in the hash index: its posting, the sequence it is read from (the
+    // posting points at the first genome with the same name), and whether it is stop-listed
+    struct AmbiguousPosting {
+        Posting posting;
+        int sequence;
+        bool stopListed;
+    };
+    
     int m_minSearchLength;
-    vector<Genome> m_genomes;
+    IndexKind m_indexKind;
+    IndexOptions m_options;
+    bool m_ambiguousIndexed;   // k-mers containing N are in the index
+    vector<string> m_genomeNames;
+    mutable SequenceStore m_sequences;   // in memory, or in a file under storageDirectory
+    bool m_storageFailed;                // storageDirectory was given but can't be used
+    unordered_map<string, int> m_genomeIndex;   // name -> first genome added with that name
     Trie<string> m_DNAs;
     
-    // Helper Function
+    // k-mer hash index: every k-mer without N and its postings. built from m_sequences on
+    // the first query after a genome is added. k-mers with N are kept apart, unless they are
+    // skipped, under their key with N read as A and compared base by base when found. they
+    // are few, so that table is always in memory. m_firstBases records which characters begin
+    // an indexed or stop-listed k-mer, the same thing the trie's root labels record.
+    // m_postingsCurrent is also false while sequences added to a file based store aren't
+    // mapped yet
+    mutable mutex m_postingsLock;
+    mutable KmerTable<Posting> m_postings;
+    mutable KmerTable<AmbiguousPosting> m_ambiguousPostings;
+    bool m_firstBases[256];
+    mutable bool m_postingsCurrent;
+    
+    // seed counters reported by queryStats
+    mutable atomic<long long> m_seedsLookedUp;
+    mutable atomic<long long> m_seedsCapped;
+    mutable atomic<long long> m_fallbackSeeds;
+    mutable atomic<long long> m_genomesSkipped;
+    mutable atomic<long long> m_cacheHits;
+    mutable atomic<long long> m_cacheMisses;
+    
+    // recent findGenomesWithThisDNA results under a hash of the fragment, minimum length, and
+    // exact match condition. each result keeps its search so that a hit can be confirmed.
+    // emptied whenever a genome is added
+    struct CachedResult {
+        string fragment;
+        int minimumLength;
+        bool exactMatchOnly;
+        vector<DNAMatch> matches;
+    };
+    mutable LRUCache<uint64_t, CachedResult> m_results;
+    
+    // k-mer membership filter of each genome, empty if filters are turned off
+    vector<BloomFilter> m_filters;
+    
+    // distinct k-mers of every genome for overlapping window scoring, for one k-mer length
+    struct KmerGenomeTable {
+        int length;
+        KmerTable<int> genomes;      // genomes containing each k-mer
+        vector<int> distinctKmers;   // number of distinct k-mers of each genome
+    };
+    
+    // built on first use for the requested k-mer length and dropped whenever a genome is
+    // added. m_kmerTableLock guards the pointer only, so a query keeps using the table it got
+    // while another length replaces it
+    mutable mutex m_kmerTableLock;
+    mutable shared_ptr<const KmerGenomeTable> m_kmerTable;
+    
+    // what the index does with a k-mer, see classifyKmers
+    enum { KMER_INDEXED, KMER_SKIPPED, KMER_STOPLISTED };
+    
+    // per thread buffers of countReadHits, sized to the number of genomes
+    struct ReadCounts {
+        vector<int> hits;       // k-mers of the read found in each genome
+        vector<int> lastKmer;   // last k-mer of the read counted for each genome
+        vector<int> touched;    // genomes with any hit
+        vector<uint64_t> codes;
+        vector<Posting> postings;
+    };
+    
+    // Helper Functions
+    //
+    // Pre-condition: seed string of minimum search length, exact match condition, vector
+    //                to store the result, and whether a seed starting with a character no
+    //                k-mer starts with may still be found as a SNiP
+    // Post-condition: look up the seed in the index and store every genome index and position
+    //                 found into the vector. returns false, with no positions, if the seed
+    //                 has more positions than maxKmerFrequency
+    bool lookupSeed(const string& seed, bool exactMatchOnly, vector<Posting>& hits,
+                    bool anyFirstBase = false) const;
+    //
+    // Pre-condition: seed string of minimum search length, exact match condition, function
+    //                taking each genome index and position and returning false to stop,
+    //                a boolean to mark a seed with a stop-listed or over the limit key, and
+    //                the first base condition of lookupSeed
+    // Post-condition: call the function with the positions lookupSeed would store without
+    //                 collecting them, and returns how many it was called with. the visit
+    //                 stops when a key found is stop-listed or over the limit
+    template<typename Visitor>
+    size_t visitSeed(const string& seed, bool exactMatchOnly, Visitor visitor, bool& limited,
+                     bool anyFirstBase = false) const;
+    //
+    // Pre-condition: fragment, minimum length of match, exact match condition, and vector
+    //                to store the result
+    // Post-condition: look up the first seed of the fragment that is searchable and not over
+    //                 the frequency limit, trying later offsets within minimum length when
+    //                 one isn't. store every position the fragment would start at when the
+    //                 seed matches there into the vector and returns false if no seed worked
+    bool seedFragment(const string& fragment, int minimumLength, bool exactMatchOnly,
+                      vector<Posting>& hits) const;
+    //
+    // Pre-condition: same as above, but a function taking each position and returning false
+    //                to stop instead of the vector
+    // Post-condition: same seed as seedFragment, but each position is handed to the function
+    //                 as it is found. seeds are counted before their positions are handed
+    //                 out, so that one over the frequency limit hands out none
+    template<typename Visitor>
+    bool streamFragment(const string& fragment, int minimumLength, bool exactMatchOnly,
+                        Visitor visitor) const;
+    //
+    // Pre-condition: fragment, offset of a seed in it, and exact match condition
+    // Post-condition: returns false if the seed contains N that isn't indexed and can't be
+    //                 the one SNiP either, since the index can't answer it
+    bool seedSearchable(const string& fragment, int offset, bool exactMatchOnly) const;
+    //
+    // Pre-condition: pointer to a seed, index and position of a sequence, exact match condition
+    // Post-condition: returns true if the seed and the sequence's k-mer at the position are
+    //                 the same, or differ in one character if exactMatchOnly is false
+    bool seedMatchesAt(const char* seed, int sequence, int position, bool exactMatchOnly) const;
+    //
+    // Pre-condition: pointer to a window of the query, its length, exact match condition, and
+    //                vector of flags per genome
+    // Post-condition: clear the flag of every genome whose filter shows the window can't match
+    //                 it. the first seed has to be in the genome for an exact match, and for
+    //                 SNiPs the first or second seed when the window holds two of them
+    void filterCandidates(const char* window, int length, bool exactMatchOnly,
+                          vector<char>& candidates) const;
+    //
+    // Pre-condition: genome sequence and vector to store the result
+    // Post-condition: store for each k-mer start position whether the index options index
+    //                 the k-mer, skip it (unindexed N), or stop-list it (low complexity)
+    void classifyKmers(const char* sequence, int length, vector<char>& kinds) const;
+    //
+    // Pre-condition: sequence, DUST window length and score threshold, vector to store result
+    // Post-condition: mark every base inside a window whose DUST score (pairs of equal base
+    //                 triplets per triplet) is above the threshold
+    static void maskLowComplexity(const char* sequence, int length, int window, double threshold,
+                                  vector<char>& masked);
+    //
+    // Pre-condition: N/A
+    // Post-condition: map the sequences added since the last call and build the k-mer hash
+    //                 index if it is in use and a genome was added since it was last built.
+    //                 has to be called before lookupSeed or reading m_sequences by every query
+    void prepareIndex() const;
+    //
+    // Pre-condition: pointer to a seed of minimum search length
+    // Post-condition: start loading the hash index slot of the seed into cache, and its postings
+    //                 from disk if they are mapped, so that a later lookupSeed of it doesn't
+    //                 wait. does nothing for the trie
+    void prefetchSeed(const char* seed) const;
+    //
+    // Pre-condition: fragment, genome index, starting position in the genome, maximum number
+    //                of edits, indel condition, and an int to store number of edits used
+    // Post-condition: returns the length of the longest prefix of fragment that aligns to the
+    //                 genome starting at the position with at most maxEdits edits
+    int alignPrefix(const string& fragment, int genome, int start, int maxEdits,
+                    bool allowIndels, int& editsUsed) const;
+    //
+    // Pre-condition: fragment, exact match condition, vector of flags per genome
+    // Post-condition: set the flag of every genome that matches the whole fragment, allowing
+    //                 1 mismatch if exactMatchOnly is false, and returns the number of them
+    int markMatchingGenomes(const string& fragment, bool exactMatchOnly,
+                            vector<char>& matched, vector<Posting>& hits) const;
+    //
+    // Pre-condition: k-mer length up to MAX_ENCODED_KMER_LENGTH
+    // Post-condition: returns the k-mer table for the length, building it first unless it
+    //                 is already built for it
+    shared_ptr<const KmerGenomeTable> kmerTable(int k) const;
     //
-    // Pre-condition: string of fragment, exact match condition, DNAMatch object
-    // Post-condition: index characters of sequence starting from Genome and position
-    //                 specified by DNAMatch. Then count the number of matching characters
-    //                 with fragment and store it to DNAMatch object.
-    void findMatching(const string& fragment, bool exactMatchOnly, DNAMatch& match) const;
+    // Pre-condition: string of fragment, exact match condition, genome index and position
+    // Post-condition: returns the number of characters of fragment matching the genome
+    //                 starting at the position, allowing 1 mismatch if exactMatchOnly is false
+    int matchLength(const string& fragment, bool exactMatchOnly, int genome, int position) const;
+    //
+    // Pre-condition: pointer to a read, its length, and buffers with every hit zero and every
+    //                lastKmer negative. prepareIndex has been called
+    // Post-condition: count for each genome how many k-mers of the read are found in it, at
+    //                 most once per k-mer, and assign the read to the best one. the buffers
+    //                 are cleared again afterwards
+    void assignRead(const char* read, int length, ReadCounts& counts,
+                    ReadAssignment& assignment) const;
 };
 
-GenomeMatcherImpl::GenomeMatcherImpl(int minSearchLength)
-                  :m_minSearchLength(minSearchLength) {}
+GenomeMatcherImpl::GenomeMatcherImpl(int minSearchLength, IndexKind index,
+                                     const IndexOptions& options)
+                  :m_minSearchLength(minSearchLength),
+                   m_indexKind(minSearchLength <= MAX_ENCODED_KMER_LENGTH ? index : IndexKind::Trie),
+                   m_options(options),
+                   m_DNAs(options.maxKmerFrequency > 0 ? options.maxKmerFrequency : 0),
+                   m_postingsCurrent(false),
+                   m_seedsLookedUp(0), m_seedsCapped(0), m_fallbackSeeds(0), m_genomesSkipped(0),
+                   m_cacheHits(0), m_cacheMisses(0),
+                   m_results(options.resultCacheEntries > 0 ? options.resultCacheEntries : 0,
+                             options.resultCacheBytes > 0 ? options.resultCacheBytes : 0)
+{
+    m_ambiguousIndexed = !options.skipAmbiguousKmers;
+    fill(m_firstBases, m_firstBases + 256, false);
+    
+    // without a usable directory no genome can be added
+    m_storageFailed = !m_options.storageDirectory.empty() &&
+                      !m_sequences.useFile(m_options.storageDirectory + "/sequences.bin");
+}
 
-void GenomeMatcherImpl::addGenome(const Genome& genome)
+bool GenomeMatcherImpl::addGenome(const Genome& genome)
 {
     // Try to extract first fragment of the sequence up to minimum search length and if
     // it succeeds, add genome into vector and insert every subset fragment (length of
-    // minimum search length) of sequence into the trie.
+    // minimum search length) of sequence into the trie. the hash index is instead rebuilt
+    // from the stored sequences by the next query.
     string temp;
     int i = 0;
+    if (m_storageFailed) return false;
     if (!genome.extract(i, m_minSearchLength, temp))
-        return;
-    m_genomes.push_back(genome);
-    m_DNAs.insert(temp, genome.name() + ", position " + to_string(i));
-    while (genome.extract(++i, m_minSearchLength, temp)) {
-        m_DNAs.insert(temp, genome.name() + ", position " + to_string(i));
+        return true;
+    string sequence;
+    genome.extract(0, genome.length(), sequence);
+    if (!m_sequences.add(sequence)) return false;
+    if (m_genomeIndex.find(genome.name()) == m_genomeIndex.end())
+        m_genomeIndex[genome.name()] = static_cast<int>(m_genomeNames.size());
+    m_genomeNames.push_back(genome.name());
+    m_kmerTable.reset();
+    m_postingsCurrent = false;
+    m_results.clear();
+    
+    // the filter holds every k-mer of the sequence no matter what the index leaves out
+    if (m_options.filterFalsePositiveRate > 0) {
+        BloomFilter filter(sequence.size() - m_minSearchLength + 1, m_options.filterFalsePositiveRate,
+                           m_options.maxFilterBytesPerGenome > 0 ? m_options.maxFilterBytesPerGenome : 0);
+        uint64_t key;
+        for (int p = 0; p + m_minSearchLength <= static_cast<int>(sequence.size()); ++p)
+            if (encodeKmer(sequence.data() + p, m_minSearchLength, key))
+                filter.insert(key);
+        m_filters.push_back(filter);
+    }
+    
+    // every k-mer the index doesn't skip, stop-listed or not, gives its first base
+    int lastN = INT_MIN;
+    for (int p = 0; p < static_cast<int>(sequence.size()); ++p) {
+        if (!m_ambiguousIndexed && encodeBase(sequence[p]) < 0) lastN = p;
+        const int start = p - m_minSearchLength + 1;
+        if (start >= 0 && lastN < start)
+            m_firstBases[static_cast<unsigned char>(sequence[start])] = true;
+    }
+
+    if (m_indexKind != IndexKind::Trie)
+        return true;
+    vector<char> kinds;
+    classifyKmers(sequence.data(), static_cast<int>(sequence.size()), kinds);
+    const string valuePrefix = genome.name() + ", position ";
+    for (; i + m_minSearchLength <= static_cast<int>(sequence.size()); ++i) {
+        if (kinds[i] == KMER_SKIPPED) continue;
+        temp.assign(sequence, i, m_minSearchLength);
+        if (kinds[i] == KMER_INDEXED)
+            m_DNAs.insert(temp, valuePrefix + to_string(i));
+        else
+            m_DNAs.stopList(temp);
     }
+    return true;
+}
+
+void GenomeMatcherImpl::addFirstBases(const string& bases)
+{
+    for (auto it = bases.begin(); it != bases.end(); ++it)
+        m_firstBases[static_cast<unsigned char>(*it)] = true;
+    m_results.clear();
 }
 
 int GenomeMatcherImpl::minimumSearchLength() const
 { return m_minSearchLength; }
 
+string GenomeMatcherImpl::firstBases() const
+{
+    string bases;
+    for (int c = 0; c < 256; ++c)
+        if (m_firstBases[c]) bases += static_cast<char>(c);
+    return bases;
+}
+
+IndexKind GenomeMatcherImpl::indexKind() const
+{ return m_indexKind; }
+
+QueryStats GenomeMatcherImpl::queryStats() const
+{
+    QueryStats stats;
+    stats.seedsLookedUp = m_seedsLookedUp;
+    stats.seedsCapped   = m_seedsCapped;
+    stats.fallbackSeeds = m_fallbackSeeds;
+    stats.genomesSkipped = m_genomesSkipped;
+    stats.cacheHits     = m_cacheHits;
+    stats.cacheMisses   = m_cacheMisses;
+    return stats;
+}
+
+void GenomeMatcherImpl::resetQueryStats()
+{
+    m_seedsLookedUp = 0;
+    m_seedsCapped   = 0;
+    m_fallbackSeeds = 0;
+    m_genomesSkipped = 0;
+    m_cacheHits     = 0;
+    m_cacheMisses   = 0;
+}
+
 bool GenomeMatcherImpl::findGenomesWithThisDNA(const string& fragment,
                                                int minimumLength,
                                                bool exactMatchOnly,
@@ -89,67 +467,585 @@ bool GenomeMatcherImpl::findGenomesWithThisDNA(const string& fragment,
 {
     // If fragment is shorter than minimum length or minimum length smaller than
     // minimum search length, return false
-    if (fragment.size() < minimumLength)   return false;
+    if (static_cast<int>(fragment.size()) < minimumLength)   return false;
     if (minimumLength < m_minSearchLength) return false;
+    
+    // answer from the cache if the same search was done since the library last changed. a
+    // search whose hash another one shares is only answered by comparing the fragment
+    const bool cached = m_results.capacity() > 0;
+    uint64_t cacheKey = 0;
+    if (cached) {
+        cacheKey = hash<string>()(fragment) ^
+                   (static_cast<uint64_t>(minimumLength) << 1 | exactMatchOnly) * 0x9E3779B97F4A7C15ULL;
+        bool found = m_results.find(cacheKey, [&](const CachedResult& result) {
+            if (result.minimumLength != minimumLength || result.exactMatchOnly != exactMatchOnly ||
+                result.fragment != fragment)
+                return false;
+            matches = result.matches;
+            return true;
+        });
+        if (found) {
+            m_cacheHits++;
+            return !(matches.empty());
+        }
+        m_cacheMisses++;
+    }
 
-    // use trie's find function to get all genomes that has matching up to minimum search length
-    // then create DNAMatch object with each one of the result and use findMatching function to
-    // define the actual matching length at that position. then store the result into hash table
-    // to calculate maximum length for each genome
-    unordered_map<string, DNAMatch> umap;
-    vector<string> match = m_DNAs.find(fragment.substr(0, m_minSearchLength), exactMatchOnly);
-    for (auto it = match.begin(); it != match.end(); ++it) {
-        string name = (*it).substr(0, (*it).find(", position"));
-        int position = stoi((*it).substr((*it).find(", position") + 11));
-        DNAMatch newMatch;
-        newMatch.genomeName = name;
-        newMatch.length     = 0;
-        newMatch.position   = position;
-        findMatching(fragment, exactMatchOnly, newMatch);
-        auto umapItr = umap.find(newMatch.genomeName);
-        if (umapItr == umap.end() || umapItr->second.length < newMatch.length)
-            umap[newMatch.genomeName] = newMatch;
+    // use the index to get all genomes that has matching up to minimum search length then
+    // use matchLength function to define the actual matching length at each position. keep
+    // the longest match for each genome, and the lowest position among equally long ones so
+    // the answer doesn't depend on the order the index returns positions in
+    prepareIndex();
+    vector<Posting> hits;
+    seedFragment(fragment, minimumLength, exactMatchOnly, hits);
+    vector<int> bestLength(m_sequences.size(), -1);
+    vector<int> bestPosition(m_sequences.size(), 0);
+    for (auto it = hits.begin(); it != hits.end(); ++it) {
+        int length = matchLength(fragment, exactMatchOnly, it->genome, it->position);
+        if (bestLength[it->genome] < length ||
+            (bestLength[it->genome] == length && bestPosition[it->genome] > it->position)) {
+            bestLength[it->genome]   = length;
+            bestPosition[it->genome] = it->position;
+        }
     }
     
     // if result has matching length bigger or equal to minimum length, store it to vector
     matches.clear();
-    for (auto it = umap.begin(); it != umap.end(); ++it)
-        if (it->second.length >= minimumLength)
-            matches.push_back(it->second);
+    for (int g = 0; g < static_cast<int>(bestLength.size()); ++g) {
+        if (bestLength[g] >= minimumLength) {
+            DNAMatch newMatch;
+            newMatch.genomeName = m_genomeNames[g];
+            newMatch.length     = bestLength[g];
+            newMatch.position   = bestPosition[g];
+            matches.push_back(newMatch);
+        }
+    }
+    if (cached) {
+        size_t bytes = sizeof(CachedResult) + fragment.size() + matches.size() * sizeof(DNAMatch);
+        for (auto it = matches.begin(); it != matches.end(); ++it)
+            bytes += it->genomeName.size();
+        m_results.insert(cacheKey, bytes, [&](CachedResult& result) {
+            result.fragment       = fragment;
+            result.minimumLength  = minimumLength;
+            result.exactMatchOnly = exactMatchOnly;
+            result.matches        = matches;
+        });
+    }
     return !(matches.empty());  // returns if found a genome that satisfies
 }
 
-void GenomeMatcherImpl::findMatching(const string& fragment,
-                                     bool exactMatchOnly,
-                                     DNAMatch& match) const
+int GenomeMatcherImpl::matchLength(const string& fragment, bool exactMatchOnly,
+                                   int genome, int position) const
 {
-    // find the genome in the vector that matches the name
-    auto it = m_genomes.begin();
-    for (; it != m_genomes.end(); ++it)
-        if (it->name() == match.genomeName) break;
+    // allow 1 mismatch (SNiP) if exact match is set to false
+    const int numAllowedMismatch = exactMatchOnly ? 0 : 1;
+    const char* sequence = m_sequences.data(genome);
+    const int seqLength = m_sequences.length(genome);
+    int misCount = 0;
+    int length = 0;
     
-    if (it != m_genomes.end()) {
-        // allow 1 mismatch (SNiP) if exact match is set to false
-        const int numAllowedMismatch = exactMatchOnly ? 0 : 1;
-        int misCount = 0;
-        string ch;
+    // starting from the position, iterate each character and increase length if they
+    // are matching with the fragment. stops if mismatch counter is no
+    for (int i = position; i < seqLength && i < static_cast<int>(fragment.size()) + position; ++i) {
+        if (sequence[i] == fragment[i - position]) {
+            length++;
+        }
+        else if (misCount < numAllowedMismatch) {
+            misCount++;
+            length++;
+        }
+        else break;
+    }
+    return length;
+}
+
+int GenomeMatcherImpl::enumerateDNAMatches(const string& fragment,
+                                           int minimumLength,
+                                           bool exactMatchOnly,
+                                           const DNAMatchCallback& callback,
+                                           int maxMatchesPerGenome) const
+{
+    // same length requirements as findGenomesWithThisDNA
+    if (static_cast<int>(fragment.size()) < minimumLength)   return 0;
+    if (minimumLength < m_minSearchLength) return 0;
+    
+    // extend every seed hit as the index finds it and hand each qualifying one straight to
+    // the callback. only a counter per genome is kept so that the cap can be enforced
+    prepareIndex();
+    vector<int> reported(m_sequences.size(), 0);
+    int total = 0;
+    DNAMatch match;
+    streamFragment(fragment, minimumLength, exactMatchOnly, [&](const Posting& hit) {
+        if (maxMatchesPerGenome > 0 && reported[hit.genome] >= maxMatchesPerGenome)
+            return true;
+        int length = matchLength(fragment, exactMatchOnly, hit.genome, hit.position);
+        if (length < minimumLength) return true;
+        match.genomeName = m_genomeNames[hit.genome];
+        match.length     = length;
+        match.position   = hit.position;
+        reported[hit.genome]++;
+        total++;
+        return callback(match);
+    });
+    return total;
+}
+
+bool GenomeMatcherImpl::lookupSeed(const string& seed, bool exactMatchOnly,
+                                   vector<Posting>& hits, bool anyFirstBase) const
+{
+    hits.clear();
+    m_seedsLookedUp++;
+    const size_t maxHits = m_options.maxKmerFrequency > 0 ? m_options.maxKmerFrequency : 0;
+    bool limited;
+    size_t found = visitSeed(seed, exactMatchOnly,
+                             [&hits](const Posting& hit) { hits.push_back(hit); return true; },
+                             limited, anyFirstBase);
+    if (limited || (maxHits > 0 && found > maxHits)) {
+        hits.clear();
+        m_seedsCapped++;
+        return false;
+    }
+    return true;
+}
+
+template<typename Visitor>
+size_t GenomeMatcherImpl::visitSeed(const string& seed, bool exactMatchOnly, Visitor visitor,
+                                    bool& limited, bool anyFirstBase) const
+{
+    size_t visited = 0;
+    limited = false;
+    
+    // like Trie::find, nothing is found when no indexed k-mer starts with the first character
+    if (!anyFirstBase && !m_firstBases[static_cast<unsigned char>(seed[0])]) return 0;
+    if (m_indexKind == IndexKind::Trie) {
+        // values in the trie are stored as "name, position i". convert each of them to
+        // the index of the genome and the position
+        return m_DNAs.visit(seed, exactMatchOnly, [&](const string& value) {
+            size_t split = value.find(", position");
+            Posting hit;
+            hit.genome   = m_genomeIndex.find(value.substr(0, split))->second;
+            hit.position = stoi(value.substr(split + 11));
+            return visitor(hit);
+        }, limited);
+    }
+    
+    // encode the seed with N read as A. a seed with N finds k-mers without N only by taking
+    // the N as the one SNiP
+    uint64_t code = 0;
+    int unencodable = -1;
+    int numUnencodable = 0;
+    for (int i = 0; i < m_minSearchLength; ++i) {
+        int base = encodeBase(seed[i]);
+        if (base < 0) {
+            unencodable = i;
+            numUnencodable++;
+            base = 0;
+        }
+        code = (code << 2) | static_cast<uint64_t>(base);
+    }
+    
+    // the seed itself, then for SNiPs every key differing from it in one base, or only at
+    // its N. all keys are prefetched before any of them is probed so their cache misses overlap
+    uint64_t keys[3 * MAX_ENCODED_KMER_LENGTH + 1];
+    int numKeys = 0;
+    if (numUnencodable == 0)
+        keys[numKeys++] = code;
+    if (!exactMatchOnly && numUnencodable <= 1) {
+        for (int i = 0; i < m_minSearchLength; ++i) {
+            if (numUnencodable == 1 && i != unencodable) continue;
+            const int shift = 2 * (m_minSearchLength - 1 - i);
+            const uint64_t original = (code >> shift) & 3;
+            for (uint64_t base = 0; base < 4; ++base) {
+                if (numUnencodable == 0 && base == original) continue;
+                keys[numKeys++] = (code & ~(uint64_t(3) << shift)) | (base << shift);
+            }
+        }
+    }
+    for (int k = 0; k < numKeys; ++k)
+        m_postings.prefetch(keys[k]);
+    for (int k = 0; k < numKeys; ++k) {
+        const Posting* first;
+        int count = m_postings.find(keys[k], first);
+        if (count < 0) {
+            limited = true;
+            return visited;
+        }
+        for (int c = 0; c < count; ++c) {
+            visited++;
+            if (!visitor(first[c])) return visited;
+        }
+    }
+    
+    // k-mers with N agree with the seed, N read as A, in all but at most the SNiP's base.
+    // the ones found under those keys are compared with the seed itself
+    if (m_ambiguousPostings.keyCount() == 0) return visited;
+    numKeys = 0;
+    keys[numKeys++] = code;
+    if (!exactMatchOnly) {
+        for (int i = 0; i < m_minSearchLength; ++i) {
+            const int shift = 2 * (m_minSearchLength - 1 - i);
+            const uint64_t original = (code >> shift) & 3;
+            for (uint64_t base = 0; base < 4; ++base)
+                if (base != original)
+                    keys[numKeys++] = (code & ~(uint64_t(3) << shift)) | (base << shift);
+        }
+    }
+    for (int k = 0; k < numKeys; ++k) {
+        const AmbiguousPosting* first;
+        int count = m_ambiguousPostings.find(keys[k], first);
+        for (int c = 0; c < count; ++c) {
+            if (!seedMatchesAt(seed.data(), first[c].sequence, first[c].posting.position,
+                               exactMatchOnly))
+                continue;
+            if (first[c].stopListed) {
+                limited = true;
+                return visited;
+            }
+            visited++;
+            if (!visitor(first[c].posting)) return visited;
+        }
+    }
+    return visited;
+}
+
+bool GenomeMatcherImpl::seedMatchesAt(const char* seed, int sequence, int position,
+                                      bool exactMatchOnly) const
+{
+    const char* kmer = m_sequences.data(sequence) + position;
+    int mismatches = 0;
+    for (int i = 0; i < m_minSearchLength; ++i)
+        if (seed[i] != kmer[i] && ++mismatches > (exactMatchOnly ? 0 : 1)) return false;
+    return true;
+}
+
+bool GenomeMatcherImpl::seedFragment(const string& fragment, int minimumLength,
+                                     bool exactMatchOnly, vector<Posting>& hits) const
+{
+    // any match of minimumLength covers every seed that ends within minimumLength, so when
+    // the first seed can't be used, a later one finds the same starting positions
+    for (int offset = 0; offset + m_minSearchLength <= minimumLength; ++offset) {
+        if (!seedSearchable(fragment, offset, exactMatchOnly)) {
+            m_seedsCapped++;
+            continue;
+        }
+        if (!lookupSeed(fragment.substr(offset, m_minSearchLength), exactMatchOnly, hits))
+            continue;
+        if (offset > 0) {
+            m_fallbackSeeds++;
+            size_t kept = 0;
+            for (size_t h = 0; h < hits.size(); ++h) {
+                if (hits[h].position < offset) continue;
+                hits[kept] = hits[h];
+                hits[kept++].position -= offset;
+            }
+            hits.resize(kept);
+        }
+        return true;
+    }
+    hits.clear();
+    return false;
+}
+
+template<typename Visitor>
+bool GenomeMatcherImpl::streamFragment(const string& fragment, int minimumLength,
+                                       bool exactMatchOnly, Visitor visitor) const
+{
+    // the same fallback as seedFragment. counting first visits the seed's keys twice, which
+    // is cheaper than holding every position of a frequent seed
+    const size_t maxHits = m_options.maxKmerFrequency > 0 ? m_options.maxKmerFrequency : 0;
+    for (int offset = 0; offset + m_minSearchLength <= minimumLength; ++offset) {
+        if (!seedSearchable(fragment, offset, exactMatchOnly)) {
+            m_seedsCapped++;
+            continue;
+        }
+        const string seed = fragment.substr(offset, m_minSearchLength);
+        m_seedsLookedUp++;
+        bool limited;
+        size_t found = visitSeed(seed, exactMatchOnly, [](const Posting&) { return true; }, limited);
+        if (limited || (maxHits > 0 && found > maxHits)) {
+            m_seedsCapped++;
+            continue;
+        }
+        if (offset > 0) m_fallbackSeeds++;
+        visitSeed(seed, exactMatchOnly, [&](const Posting& hit) {
+            if (hit.position < offset) return true;
+            Posting shifted = hit;
+            shifted.position -= offset;
+            return visitor(shifted);
+        }, limited);
+        return true;
+    }
+    return false;
+}
+
+bool GenomeMatcherImpl::seedSearchable(const string& fragment, int offset,
+                                       bool exactMatchOnly) const
+{
+    if (m_ambiguousIndexed) return true;
+    int unencodable = 0;
+    for (int i = offset; i < offset + m_minSearchLength; ++i)
+        if (encodeBase(fragment[i]) < 0) ++unencodable;
+    return unencodable <= (exactMatchOnly ? 0 : 1);
+}
+
+void GenomeMatcherImpl::classifyKmers(const char* sequence, int length, vector<char>& kinds) const
+{
+    // a k-mer with an unindexed N is skipped, and one with a masked base is stop-listed so
+    // that queries seeding on it fall back to another seed instead of finding nothing.
+    // lastN and lastMasked are the latest such bases seen, so the k-mer starting at start
+    // contains one if it is at or after start
+    const int n = length;
+    kinds.assign(n, KMER_INDEXED);
+    vector<char> masked;
+    if (m_options.maskLowComplexity)
+        maskLowComplexity(sequence, length, m_options.dustWindow, m_options.dustThreshold, masked);
+    int lastN = INT_MIN;
+    int lastMasked = INT_MIN;
+    for (int i = 0; i < n; ++i) {
+        if (!m_ambiguousIndexed && encodeBase(sequence[i]) < 0) lastN = i;
+        if (!masked.empty() && masked[i]) lastMasked = i;
+        const int start = i - m_minSearchLength + 1;
+        if (start < 0) continue;
+        if (lastN >= start)           kinds[start] = KMER_SKIPPED;
+        else if (lastMasked >= start) kinds[start] = KMER_STOPLISTED;
+    }
+}
+
+void GenomeMatcherImpl::maskLowComplexity(const char* sequence, int length, int window,
+                                          double threshold, vector<char>& masked)
+{
+    const int n = length;
+    masked.assign(n, false);
+    if (window < 4 || n < 4) return;
+    
+    // slide a window of triplets over the sequence. pairs counts the pairs of equal triplets
+    // in the window and is updated as each triplet enters and leaves it
+    auto triplet = [&](int i) {
+        int a = encodeBase(sequence[i]), b = encodeBase(sequence[i + 1]), c = encodeBase(sequence[i + 2]);
+        return (a < 0 || b < 0 || c < 0) ? -1 : (a << 4) | (b << 2) | c;
+    };
+    const int tripletsPerWindow = window - 2;
+    int counts[64] = { 0 };
+    long long pairs = 0;
+    int maskedUntil = 0;   // bases before this index are already masked
+    for (int i = 0; i + 2 < n; ++i) {
+        int t = triplet(i);
+        if (t >= 0) pairs += counts[t]++;
+        const int first = i - tripletsPerWindow + 1;
+        if (first > 0) {
+            int old = triplet(first - 1);
+            if (old >= 0) pairs -= --counts[old];
+        }
         
-        // starting from the position specified in DNAMatch, iterate each character and
-        // increase length if they are matching with the fragment. stops if mismatch
-        // counter is no
-        for (int i = match.position; i < it->length() && i < fragment.size() + match.position; ++i) {
-            if (it->extract(i, 1, ch)) {
-                if (ch == fragment.substr(i - match.position, 1)) {
-                    match.length++;
+        // score full windows, or the whole sequence once if it is shorter than a window
+        const int inWindow = i - max(first, 0) + 1;
+        if (inWindow < tripletsPerWindow && i + 3 < n) continue;
+        if (inWindow < 2 || (double)(pairs) / (inWindow - 1) <= threshold) continue;
+        for (int j = max(maskedUntil, max(first, 0)); j < i + 3; ++j)
+            masked[j] = true;
+        maskedUntil = i + 3;
+    }
+}
+
+void GenomeMatcherImpl::prepareIndex() const
+{
+    lock_guard<mutex> guard(m_postingsLock);
+    if (m_postingsCurrent) return;
+    m_sequences.refresh();
+    m_postingsCurrent = true;
+    if (m_indexKind == IndexKind::Trie) return;
+    
+    // postings of a genome point at the first genome with its name, same as the trie which
+    // stores genomes by name. the same k-mers are generated for the table in memory and for
+    // the mapped one, which needs them twice. k-mers with N go to their own table on the
+    // first pass
+    m_ambiguousPostings.reset();
+    bool ambiguousStaged = false;
+    auto generate = [&](const KmerTable<Posting>::InsertFunction& insert,
+                        const KmerTable<Posting>::StopListFunction& stopList) {
+        vector<char> kinds;
+        for (int g = 0; g < m_sequences.size(); ++g) {
+            const char* sequence = m_sequences.data(g);
+            const int length = m_sequences.length(g);
+            KmerRoller roller(m_minSearchLength);
+            Posting newPosting;
+            newPosting.genome = m_genomeIndex.find(m_genomeNames[g])->second;
+            classifyKmers(sequence, length, kinds);
+            for (int i = 0; i < length; ++i) {
+                const bool encodable = roller.push(sequence[i]);
+                newPosting.position = i - m_minSearchLength + 1;
+                if (newPosting.position < 0) continue;
+                if (!encodable) {
+                    // the roller only fails on a full k-mer when it contains N
+                    if (ambiguousStaged || kinds[newPosting.position] == KMER_SKIPPED) continue;
+                    AmbiguousPosting ambiguous;
+                    ambiguous.posting    = newPosting;
+                    ambiguous.sequence   = g;
+                    ambiguous.stopListed = kinds[newPosting.position] == KMER_STOPLISTED;
+                    uint64_t key = 0;
+                    for (int j = newPosting.position; j <= i; ++j)
+                        key = (key << 2) | static_cast<uint64_t>(max(encodeBase(sequence[j]), 0));
+                    m_ambiguousPostings.insert(key, ambiguous);
+                    continue;
                 }
-                else if (misCount < numAllowedMismatch) {
-                    misCount++;
-                    match.length++;
+                if (kinds[newPosting.position] == KMER_STOPLISTED)
+                    stopList(roller.code());
+                if (kinds[newPosting.position] != KMER_INDEXED) continue;
+                insert(roller.code(), newPosting);
+            }
+        }
+        ambiguousStaged = true;
+    };
+    const size_t maxValues = m_options.maxKmerFrequency > 0 ? m_options.maxKmerFrequency : 0;
+    
+    // the mapped table keeps the postings of its most frequent k-mers in memory
+    if (!m_options.storageDirectory.empty()) {
+        const size_t hotBytes = m_options.hotPostingBytes > 0 ? m_options.hotPostingBytes : 0;
+        if (m_postings.buildMapped(m_options.storageDirectory + "/postings", generate,
+                                   maxValues, hotBytes)) {
+            m_ambiguousPostings.build();
+            return;
+        }
+    }
+    m_postings.reset();
+    generate([this](uint64_t key, const Posting& posting) { m_postings.insert(key, posting); },
+             [this](uint64_t key) { m_postings.stopList(key); });
+    m_postings.build(maxValues);
+    m_ambiguousPostings.build();
+}
+
+void GenomeMatcherImpl::prefetchSeed(const char* seed) const
+{
+    if (m_indexKind == IndexKind::Trie) return;
+    uint64_t code = 0;
+    for (int i = 0; i < m_minSearchLength; ++i) {
+        int base = encodeBase(seed[i]);
+        if (base < 0) return;
+        code = (code << 2) | static_cast<uint64_t>(base);
+    }
+    m_postings.prefetch(code);
+    m_postings.willNeed(code);
+}
+
+bool GenomeMatcherImpl::findGenomesWithSimilarDNA(const string& fragment,
+                                                  int minimumLength,
+                                                  int maxEdits,
+                                                  bool allowIndels,
+                                                  vector<DNAMatch>& matches) const
+{
+    // same length requirements as findGenomesWithThisDNA, and edit budget can't be negative
+    if (static_cast<int>(fragment.size()) < minimumLength)   return false;
+    if (minimumLength < m_minSearchLength) return false;
+    if (maxEdits < 0)                      return false;
+    
+    // a match of minimumLength with at most maxEdits edits contains one of the disjoint
+    // seeds within its first minimumLength characters exactly if there are more seeds than
+    // edits. with substitutions only, one of them has at most one mismatch if there are more
+    // than half as many seeds as edits, so seeds are looked up as SNiPs when that is needed,
+    // even those starting with a character no k-mer starts with. with fewer seeds the index
+    // can't be relied on to find the match
+    const int numSeeds = minimumLength / m_minSearchLength;
+    const bool exactSeeds = numSeeds > maxEdits;
+    if (!exactSeeds && (allowIndels || 2 * numSeeds <= maxEdits)) return false;
+    
+    // each hit of the seed at offset o anchors the fragment at hit position - o, shifted by
+    // up to maxEdits when indels are allowed
+    prepareIndex();
+    const int maxShift = allowIndels ? maxEdits : 0;
+    unordered_set<long long> tried;
+    vector<DNAMatch> best(m_sequences.size());
+    vector<int> bestEdits(m_sequences.size(), INT_MAX);
+    vector<Posting> hits;
+    for (int offset = 0; offset + m_minSearchLength <= minimumLength; offset += m_minSearchLength) {
+        // seeds the index can't answer are skipped. the rest still find the match unless
+        // more seeds are lost than edits are spent elsewhere
+        if (!seedSearchable(fragment, offset, exactSeeds)) {
+            m_seedsCapped++;
+            continue;
+        }
+        if (!lookupSeed(fragment.substr(offset, m_minSearchLength), exactSeeds, hits, true))
+            continue;
+        for (auto it = hits.begin(); it != hits.end(); ++it) {
+            for (int shift = -maxShift; shift <= maxShift; ++shift) {
+                const int start = it->position - offset + shift;
+                if (start < 0 || start >= m_sequences.length(it->genome))
+                    continue;
+                if (!tried.insert(static_cast<long long>(it->genome) << 32 | start).second)
+                    continue;
+                
+                // verify the candidate and keep the longest match per genome. ties go to
+                // the one that used fewer edits, then to the lowest position so the answer
+                // doesn't depend on the order the index returns positions in
+                int edits;
+                int length = alignPrefix(fragment, it->genome, start, maxEdits, allowIndels, edits);
+                DNAMatch& current = best[it->genome];
+                if (bestEdits[it->genome] == INT_MAX || current.length < length ||
+                    (current.length == length && bestEdits[it->genome] > edits) ||
+                    (current.length == length && bestEdits[it->genome] == edits &&
+                     current.position > start)) {
+                    current.genomeName = m_genomeNames[it->genome];
+                    current.length     = length;
+                    current.position   = start;
+                    bestEdits[it->genome] = edits;
                 }
-                else break;
             }
         }
     }
+    
+    // if result has matching length bigger or equal to minimum length, store it to vector
+    matches.clear();
+    for (int g = 0; g < static_cast<int>(best.size()); ++g)
+        if (bestEdits[g] != INT_MAX && best[g].length >= minimumLength)
+            matches.push_back(best[g]);
+    return !(matches.empty());  // returns if found a genome that satisfies
+}
+
+int GenomeMatcherImpl::alignPrefix(const string& fragment, int genome, int start,
+                                   int maxEdits, bool allowIndels, int& editsUsed) const
+{
+    // Landau-Vishkin extension: furthest[d] is the furthest fragment index reached on
+    // diagonal d (genome offset - fragment index) using e edits. each round extends every
+    // diagonal by one edit and then slides along matching characters for free.
+    const char* text = m_sequences.data(genome) + start;
+    const char* pattern = fragment.data();
+    const int m = static_cast<int>(fragment.size());
+    const int n = m_sequences.length(genome) - start;
+    const int band = allowIndels ? maxEdits : 0;
+    const int unreachable = INT_MIN / 2;
+    
+    auto slide = [&](int i, int d) {
+        while (i < m && i + d < n && pattern[i] == text[i + d]) ++i;
+        return i;
+    };
+    
+    // diagonal d is stored at index d + band + 1 so d - 1 and d + 1 are always in range
+    vector<int> furthest(2 * band + 3, unreachable);
+    vector<int> next(2 * band + 3, unreachable);
+    furthest[band + 1] = slide(0, 0);
+    int best = furthest[band + 1];
+    editsUsed = 0;
+    
+    for (int e = 1; e <= maxEdits && best < m; ++e) {
+        fill(next.begin(), next.end(), unreachable);
+        const int reach = min(e, band);
+        for (int d = -reach; d <= reach; ++d) {
+            const int idx = d + band + 1;
+            int i = furthest[idx] + 1;                  // substitution
+            if (allowIndels) {
+                i = max(i, furthest[idx - 1]);          // genome character skipped
+                i = max(i, furthest[idx + 1] + 1);      // fragment character skipped
+            }
+            i = min(i, min(m, n - d));
+            if (i < max(0, -d)) continue;
+            next[idx] = slide(i, d);
+            if (next[idx] > best) {
+                best = next[idx];
+                editsUsed = e;
+            }
+        }
+        furthest.swap(next);
+    }
+    return best;
 }
 
 bool GenomeMatcherImpl::findRelatedGenomes(const Genome& query, int fragmentMatchLength,
@@ -161,32 +1057,60 @@ bool GenomeMatcherImpl::findRelatedGenomes(const Genome& query, int fragmentMatc
     
     // initialize variables
     const int division = query.length() / fragmentMatchLength;
-    vector<DNAMatch> matches;
-    unordered_map<string, int> umap;
-    string tempFrag;
+    const int numGenomes = static_cast<int>(m_sequences.size());
+    string sequence;
+    query.extract(0, query.length(), sequence);
     
-    // iterate division time (query length divided by piece length) and find the matching genomes
-    // and store the each genome's match into the hash table to keep track of number of matches
-    // through out the loops
-    for (int i = 0; i < division; ++i) {
-        query.extract(i * fragmentMatchLength, fragmentMatchLength, tempFrag);
-        findGenomesWithThisDNA(tempFrag, fragmentMatchLength, exactMatchOnly, matches);
-        for (auto it = matches.begin(); it != matches.end(); ++it) {
-            auto umapItr = umap.find(it->genomeName);
-            if (umapItr == umap.end())
-                umap[it->genomeName] = 1;
-            else umapItr->second++;
+    // pre-pass: count the windows each genome's filter lets through. a genome can't match
+    // more windows than that, so genomes that can't reach the threshold aren't verified
+    vector<char> active(numGenomes, true);
+    vector<char> candidates(numGenomes);
+    if (!m_filters.empty() && matchPercentThreshold > 0) {
+        vector<int> possible(numGenomes, 0);
+        for (int i = 0; i < division; ++i) {
+            fill(candidates.begin(), candidates.end(), true);
+            filterCandidates(sequence.data() + i * fragmentMatchLength, fragmentMatchLength,
+                             exactMatchOnly, candidates);
+            for (int g = 0; g < numGenomes; ++g)
+                possible[g] += candidates[g];
+        }
+        for (int g = 0; g < numGenomes; ++g) {
+            if ((double)(possible[g]) / division * 100 < matchPercentThreshold) {
+                active[g] = false;
+                m_genomesSkipped++;
+            }
         }
     }
     
-    // calculate the match percentage of each genome in the hash table and push to result vector
-    // if the percentage is higher than threshold
+    // iterate division time (query length divided by piece length) and find the matching genomes
+    // among the active ones, and count each genome's matches through out the loops. genomes
+    // left out are pre-marked as matched so markMatchingGenomes doesn't extend their hits.
+    // the next window's seed is loaded while this one is extended
+    vector<int> counts(numGenomes, 0);
+    vector<char> matched(numGenomes);
+    vector<Posting> hits;
+    string tempFrag;
+    const int numDivisions = find(active.begin(), active.end(), true) == active.end() ? 0 : division;
+    prepareIndex();
+    for (int i = 0; i < numDivisions; ++i) {
+        if (i + 1 < division)
+            prefetchSeed(sequence.data() + (i + 1) * fragmentMatchLength);
+        for (int g = 0; g < numGenomes; ++g)
+            matched[g] = !active[g];
+        tempFrag.assign(sequence, i * fragmentMatchLength, fragmentMatchLength);
+        if (markMatchingGenomes(tempFrag, exactMatchOnly, matched, hits) == 0) continue;
+        for (int g = 0; g < numGenomes; ++g)
+            if (active[g] && matched[g]) counts[g]++;
+    }
+    
+    // calculate the match percentage of each genome and push to result vector if the
+    // percentage is higher than threshold
     results.clear();
-    for (auto it = umap.begin(); it != umap.end(); ++it) {
-        if ((double)(it->second) / division * 100 >= matchPercentThreshold) {
+    for (int g = 0; g < numGenomes; ++g) {
+        if (counts[g] > 0 && (double)(counts[g]) / division * 100 >= matchPercentThreshold) {
             GenomeMatch newGM;
-            newGM.genomeName = it->first;
-            newGM.percentMatch = (double)(it->second) / division * 100;
+            newGM.genomeName = m_genomeNames[g];
+            newGM.percentMatch = (double)(counts[g]) / division * 100;
             results.push_back(newGM);
         }
     }
@@ -195,14 +1119,486 @@ bool GenomeMatcherImpl::findRelatedGenomes(const Genome& query, int fragmentMatc
     return !(results.empty());
 }
 
+void GenomeMatcherImpl::filterCandidates(const char* window, int length, bool exactMatchOnly,
+                                         vector<char>& candidates) const
+{
+    // a seed with N can't be checked, and a SNiP window with one seed may hide the mismatch
+    // in it, so those windows keep every candidate
+    const int numSeeds = exactMatchOnly ? 1 : 2;
+    if (length < numSeeds * m_minSearchLength) return;
+    uint64_t keys[2];
+    for (int s = 0; s < numSeeds; ++s)
+        if (!encodeKmer(window + s * m_minSearchLength, m_minSearchLength, keys[s])) return;
+    for (int g = 0; g < static_cast<int>(candidates.size()); ++g) {
+        if (!candidates[g]) continue;
+        bool possible = false;
+        for (int s = 0; s < numSeeds && !possible; ++s)
+            possible = m_filters[g].mayContain(keys[s]);
+        candidates[g] = possible;
+    }
+}
+
+int GenomeMatcherImpl::markMatchingGenomes(const string& fragment, bool exactMatchOnly,
+                                           vector<char>& matched, vector<Posting>& hits) const
+{
+    int count = 0;
+    seedFragment(fragment, static_cast<int>(fragment.size()), exactMatchOnly, hits);
+    for (auto it = hits.begin(); it != hits.end(); ++it) {
+        if (matched[it->genome]) continue;
+        if (matchLength(fragment, exactMatchOnly, it->genome, it->position) == static_cast<int>(fragment.size())) {
+            matched[it->genome] = true;
+            count++;
+        }
+    }
+    return count;
+}
+
+bool GenomeMatcherImpl::computeSimilarityMatrix(int fragmentMatchLength, bool exactMatchOnly,
+                                                const string& outputFile, bool sparse,
+                                                const ProgressCallback& progress) const
+{
+    // same requirement as findRelatedGenomes
+    if (fragmentMatchLength < m_minSearchLength) return false;
+    ofstream output(outputFile);
+    if (!output) return false;
+    
+    // a window that occurs in several genomes, or several times in one, matches the same
+    // genomes each time. equal windows are found by sorting the windows of the library by a
+    // hash of their bases, then by the bases, then by their place in the library, so that
+    // each run of equal windows starts with the first of them. only that one is looked up,
+    // and the others take the genomes it matched. rows are the query genomes
+    prepareIndex();
+    const int numGenomes = static_cast<int>(m_sequences.size());
+    vector<size_t> genomeWindows(numGenomes + 1, 0);   // index of each genome's first window
+    for (int g = 0; g < numGenomes; ++g)
+        genomeWindows[g + 1] = genomeWindows[g] + m_sequences.length(g) / fragmentMatchLength;
+    const size_t numWindows = genomeWindows[numGenomes];
+    vector<int> windowGenome(numWindows);
+    vector<pair<uint64_t, size_t>> order(numWindows);   // hash and index of each window
+    for (int g = 0; g < numGenomes; ++g) {
+        const char* sequence = m_sequences.data(g);
+        for (size_t w = genomeWindows[g]; w < genomeWindows[g + 1]; ++w, sequence += fragmentMatchLength) {
+            // mix in 8 bases at a time, then the rest one at a time
+            uint64_t hash = 0;
+            int i = 0;
+            for (; i + 8 <= fragmentMatchLength; i += 8) {
+                uint64_t word;
+                memcpy(&word, sequence + i, 8);
+                hash = (hash ^ word) * 0x9E3779B97F4A7C15ULL;
+                hash ^= hash >> 29;
+            }
+            for (; i < fragmentMatchLength; ++i)
+                hash = (hash ^ static_cast<unsigned char>(sequence[i])) * 0x9E3779B97F4A7C15ULL;
+            windowGenome[w] = g;
+            order[w] = make_pair(hash, w);
+        }
+    }
+    auto bases = [&](size_t w) {
+        const int g = windowGenome[w];
+        return m_sequences.data(g) + (w - genomeWindows[g]) * fragmentMatchLength;
+    };
+    sort(order.begin(), order.end(), [&](const pair<uint64_t, size_t>& a, const pair<uint64_t, size_t>& b) {
+        if (a.first != b.first) return a.first < b.first;
+        int compared = memcmp(bases(a.second), bases(b.second), fragmentMatchLength);
+        return compared != 0 ? compared < 0 : a.second < b.second;
+    });
+    
+    // firstEqual points each window at the first window with its bases. the first of several
+    // equal windows gets a list in sharedSubjects for the genomes it matches
+    vector<size_t> firstEqual(numWindows);
+    vector<int> sharedList(numWindows, -1);
+    int numShared = 0;
+    for (size_t i = 0; i < numWindows; ++i) {
+        const size_t w = order[i].second;
+        const bool same = i > 0 && order[i - 1].first == order[i].first &&
+                          memcmp(bases(order[i - 1].second), bases(w), fragmentMatchLength) == 0;
+        firstEqual[w] = same ? firstEqual[order[i - 1].second] : w;
+        if (same && sharedList[firstEqual[w]] < 0) sharedList[firstEqual[w]] = numShared++;
+    }
+    vector<pair<uint64_t, size_t>>().swap(order);
+    vector<vector<int>> sharedSubjects(numShared);
+    
+    // split the windows of every genome into blocks, the unit of work handed to a thread. a
+    // block holds about as many windows as fit in the cache, so that its lookups and
+    // extensions read bases that are still there, and there are many of them to balance
+    // genomes of different lengths over the threads
+    long cacheBytes = sysconf(_SC_LEVEL2_CACHE_SIZE);
+    if (cacheBytes <= 0) cacheBytes = 1 << 20;
+    const size_t windowsPerBlock = max<size_t>(64, cacheBytes / fragmentMatchLength);
+    const int prefetchDistance = 8;
+    vector<size_t> blockStarts;
+    for (int g = 0; g < numGenomes; ++g)
+        for (size_t w = genomeWindows[g]; w < genomeWindows[g + 1]; w += windowsPerBlock)
+            blockStarts.push_back(w);
+    blockStarts.push_back(numWindows);
+    const int numBlocks = static_cast<int>(blockStarts.size()) - 1;
+    
+    // each worker takes the next block and looks up the windows that are the first with their
+    // bases. the genomes matched are collected from the hits, counted locally for the window's
+    // genome, and added into the shared matrix once per block
+    vector<int> counts(static_cast<size_t>(numGenomes) * numGenomes, 0);
+    atomic<int> nextBlock(0);
+    int completed = 0;
+    mutex countsLock;
+    condition_variable blockDone;
+    auto worker = [&]() {
+        vector<int> blockCounts(numGenomes);
+        vector<char> matched(numGenomes, false);
+        vector<int> subjects;
+        vector<Posting> hits;
+        string window;
+        for (int b = nextBlock++; b < numBlocks; b = nextBlock++) {
+            const size_t first = blockStarts[b];
+            const size_t last = min(blockStarts[b + 1], genomeWindows[windowGenome[first] + 1]);
+            const int genome = windowGenome[first];
+            m_sequences.advise(genome, (first - genomeWindows[genome]) * fragmentMatchLength,
+                               (last - first) * fragmentMatchLength, MADV_WILLNEED);
+            fill(blockCounts.begin(), blockCounts.end(), 0);
+            for (size_t w = first; w < last; ++w) {
+                if (w + prefetchDistance < last)
+                    prefetchSeed(bases(w + prefetchDistance));
+                if (firstEqual[w] != w) continue;
+                window.assign(bases(w), fragmentMatchLength);
+                if (markMatchingGenomes(window, exactMatchOnly, matched, hits) == 0) continue;
+                subjects.clear();
+                for (auto it = hits.begin(); it != hits.end(); ++it) {
+                    if (!matched[it->genome]) continue;
+                    matched[it->genome] = false;
+                    subjects.push_back(it->genome);
+                    blockCounts[it->genome]++;
+                }
+                if (sharedList[w] >= 0) sharedSubjects[sharedList[w]] = subjects;
+            }
+            {
+                lock_guard<mutex> guard(countsLock);
+                int* row = &counts[static_cast<size_t>(genome) * numGenomes];
+                for (int g = 0; g < numGenomes; ++g)
+                    row[g] += blockCounts[g];
+                completed++;
+            }
+            blockDone.notify_one();
+        }
+    };
+    
+    // the calling thread reports progress as blocks complete, so the callback runs on it
+    // and outside the lock
+    const int numThreads = min(max(1, static_cast<int>(thread::hardware_concurrency())), numBlocks);
+    vector<thread> threads;
+    for (int t = 0; t < numThreads; ++t)
+        threads.push_back(thread(worker));
+    int reported = 0;
+    while (reported < numBlocks) {
+        int done;
+        {
+            unique_lock<mutex> lock(countsLock);
+            blockDone.wait(lock, [&]() { return completed > reported; });
+            done = completed;
+        }
+        if (progress)
+            while (reported < done) progress(++reported, numBlocks);
+        reported = done;
+    }
+    for (auto it = threads.begin(); it != threads.end(); ++it)
+        it->join();
+    
+    // the other equal windows match what the first one did
+    for (size_t w = 0; w < numWindows; ++w) {
+        if (firstEqual[w] == w) continue;
+        int* row = &counts[static_cast<size_t>(windowGenome[w]) * numGenomes];
+        const vector<int>& subjects = sharedSubjects[sharedList[firstEqual[w]]];
+        for (auto it = subjects.begin(); it != subjects.end(); ++it)
+            row[*it]++;
+    }
+    
+    // dense output is a tab separated table with a header row of subject names. sparse output
+    // lists one "query, subject, percent" line per pair with any matching window
+    output.setf(ios::fixed);
+    output.precision(2);
+    if (!sparse) {
+        for (int g = 0; g < numGenomes; ++g)
+            output << '\t' << m_genomeNames[g];
+        output << '\n';
+    }
+    for (int q = 0; q < numGenomes; ++q) {
+        const int division = m_sequences.length(q) / fragmentMatchLength;
+        if (!sparse) output << m_genomeNames[q];
+        for (int g = 0; g < numGenomes; ++g) {
+            const int count = counts[static_cast<size_t>(q) * numGenomes + g];
+            const double percentMatch = division == 0 ? 0 : (double)(count) / division * 100;
+            if (!sparse)
+                output << '\t' << percentMatch;
+            else if (count != 0)
+                output << m_genomeNames[q] << '\t' << m_genomeNames[g] << '\t' << percentMatch << '\n';
+        }
+        if (!sparse) output << '\n';
+    }
+    return static_cast<bool>(output);
+}
+
+bool GenomeMatcherImpl::findRelatedGenomesByKmers(const Genome& query, int fragmentMatchLength,
+                                                  double matchPercentThreshold,
+                                                  vector<GenomeSimilarity>& results) const
+{
+    // k-mer has to be searchable and fit into an encoded key
+    results.clear();
+    if (fragmentMatchLength < m_minSearchLength)        return false;
+    if (fragmentMatchLength > MAX_ENCODED_KMER_LENGTH) return false;
+    
+    // roll over the query once and collect the code of the k-mer at every position
+    string sequence;
+    query.extract(0, query.length(), sequence);
+    KmerRoller roller(fragmentMatchLength);
+    vector<uint64_t> codes;
+    codes.reserve(sequence.size());
+    for (auto it = sequence.begin(); it != sequence.end(); ++it)
+        if (roller.push(*it)) codes.push_back(roller.code());
+    if (codes.empty()) return false;
+    const int positions = static_cast<int>(codes.size());
+    
+    // look up each distinct k-mer once. every genome containing it shares one distinct
+    // k-mer with the query and contains as many query positions as the k-mer occurs
+    sort(codes.begin(), codes.end());
+    prepareIndex();
+    shared_ptr<const KmerGenomeTable> table = kmerTable(fragmentMatchLength);
+    vector<int> shared(m_sequences.size(), 0);
+    vector<int> contained(m_sequences.size(), 0);
+    int distinct = 0;
+    const size_t prefetchDistance = 16;
+    for (size_t i = 0; i < codes.size(); ) {
+        if (i + prefetchDistance < codes.size())
+            table->genomes.prefetch(codes[i + prefetchDistance]);
+        size_t j = i;
+        while (j < codes.size() && codes[j] == codes[i]) ++j;
+        const int* genomes;
+        int count = table->genomes.find(codes[i], genomes);
+        for (int g = 0; g < count; ++g) {
+            shared[genomes[g]]++;
+            contained[genomes[g]] += static_cast<int>(j - i);
+        }
+        distinct++;
+        i = j;
+    }
+    
+    // containment decides the threshold, same as percentMatch of findRelatedGenomes
+    for (int g = 0; g < static_cast<int>(shared.size()); ++g) {
+        double containment = (double)(contained[g]) / positions * 100;
+        if (shared[g] == 0 || containment < matchPercentThreshold) continue;
+        GenomeSimilarity newGS;
+        newGS.genomeName  = m_genomeNames[g];
+        newGS.containment = containment;
+        newGS.jaccard     = (double)(shared[g]) / (distinct + table->distinctKmers[g] - shared[g]) * 100;
+        results.push_back(newGS);
+    }
+    return !(results.empty());
+}
+
+shared_ptr<const GenomeMatcherImpl::KmerGenomeTable> GenomeMatcherImpl::kmerTable(int k) const
+{
+    lock_guard<mutex> guard(m_kmerTableLock);
+    if (m_kmerTable && m_kmerTable->length == k) return m_kmerTable;
+    
+    // stage the distinct k-mers of each genome so every key lists a genome only once
+    shared_ptr<KmerGenomeTable> table = make_shared<KmerGenomeTable>();
+    table->length = k;
+    table->distinctKmers.assign(m_sequences.size(), 0);
+    vector<uint64_t> codes;
+    for (int g = 0; g < m_sequences.size(); ++g) {
+        KmerRoller roller(k);
+        codes.clear();
+        const char* sequence = m_sequences.data(g);
+        for (int i = 0; i < m_sequences.length(g); ++i)
+            if (roller.push(sequence[i])) codes.push_back(roller.code());
+        sort(codes.begin(), codes.end());
+        codes.erase(unique(codes.begin(), codes.end()), codes.end());
+        for (auto it = codes.begin(); it != codes.end(); ++it)
+            table->genomes.insert(*it, g);
+        table->distinctKmers[g] = static_cast<int>(codes.size());
+    }
+    table->genomes.build();
+    m_kmerTable = table;
+    return m_kmerTable;
+}
+
+bool GenomeMatcherImpl::classifyRead(const string& read, ReadAssignment& assignment) const
+{
+    prepareIndex();
+    ReadCounts counts;
+    counts.hits.assign(m_sequences.size(), 0);
+    counts.lastKmer.assign(m_sequences.size(), -1);
+    assignRead(read.data(), static_cast<int>(read.size()), counts, assignment);
+    return !(assignment.genomeName.empty());
+}
+
+void GenomeMatcherImpl::assignRead(const char* read, int length, ReadCounts& counts,
+                                   ReadAssignment& assignment) const
+{
+    auto count = [&](int kmer, const Posting* first, int numPostings) {
+        for (int p = 0; p < numPostings; ++p) {
+            const int g = first[p].genome;
+            if (counts.lastKmer[g] == kmer) continue;
+            counts.lastKmer[g] = kmer;
+            if (counts.hits[g]++ == 0) counts.touched.push_back(g);
+        }
+    };
+    
+    if (m_indexKind == IndexKind::KmerHash) {
+        // encode every k-mer first so that slots can be prefetched a few k-mers ahead. k-mers
+        // with N aren't in the index and aren't looked up
+        const size_t prefetchDistance = 8;
+        KmerRoller roller(m_minSearchLength);
+        counts.codes.clear();
+        counts.touched.clear();
+        for (int i = 0; i < length; ++i)
+            if (roller.push(read[i])) counts.codes.push_back(roller.code());
+        for (size_t c = 0; c < counts.codes.size() && c < prefetchDistance; ++c)
+            m_postings.prefetch(counts.codes[c]);
+        for (size_t c = 0; c < counts.codes.size(); ++c) {
+            if (c + prefetchDistance < counts.codes.size())
+                m_postings.prefetch(counts.codes[c + prefetchDistance]);
+            const Posting* first;
+            int numPostings = m_postings.find(counts.codes[c], first);
+            if (numPostings > 0) count(static_cast<int>(c), first, numPostings);
+        }
+    }
+    else {
+        // k-mers with N are skipped the same way
+        counts.touched.clear();
+        string seed;
+        uint64_t key;
+        for (int i = 0; i + m_minSearchLength <= length; ++i) {
+            if (!encodeKmer(read + i, m_minSearchLength, key)) continue;
+            seed.assign(read + i, m_minSearchLength);
+            if (!lookupSeed(seed, true, counts.postings)) continue;
+            count(i, counts.postings.data(), static_cast<int>(counts.postings.size()));
+        }
+    }
+    
+    // the most hits wins, and the first genome added among equals so the answer is the same
+    // for both indexes
+    int best = -1;
+    int bestHits = 0;
+    bool ambiguous = false;
+    for (auto it = counts.touched.begin(); it != counts.touched.end(); ++it) {
+        const int g = *it;
+        if (counts.hits[g] > bestHits || (counts.hits[g] == bestHits && g < best)) {
+            ambiguous = counts.hits[g] == bestHits;
+            best = g;
+            bestHits = counts.hits[g];
+        }
+        else if (counts.hits[g] == bestHits) ambiguous = true;
+    }
+    for (auto it = counts.touched.begin(); it != counts.touched.end(); ++it) {
+        counts.hits[*it] = 0;
+        counts.lastKmer[*it] = -1;
+    }
+    assignment.genomeName = best < 0 ? "" : m_genomeNames[best];
+    assignment.hits       = bestHits;
+    assignment.ambiguous  = ambiguous;
+}
+
+bool GenomeMatcherImpl::classifyReads(const string& readsFile, const string& outputFile,
+                                      long long& readsClassified, int numThreads) const
+{
+    readsClassified = 0;
+    FastqReader reader;
+    if (!reader.open(readsFile)) return false;
+    ofstream output(outputFile);
+    if (!output) return false;
+    prepareIndex();
+    
+    // the reader fills batches of reads, workers assign every read of a batch, and this
+    // thread writes finished batches in the order they were read. the window keeps the
+    // reader at most a few batches ahead of the writer, so only those are in memory however
+    // long the file is and however slow one batch is
+    const int batchSize = 1024;
+    struct Batch {
+        long long number;
+        vector<string> names;
+        vector<string> reads;
+        vector<ReadAssignment> assignments;
+    };
+    if (numThreads <= 0)
+        numThreads = max(1, static_cast<int>(thread::hardware_concurrency()));
+    BoundedQueue<Batch> toClassify(2 * numThreads);
+    BoundedQueue<Batch> toWrite(2 * numThreads);
+    ReorderWindow window(4 * numThreads);
+    
+    thread readerThread([&]() {
+        long long number = 0;
+        Batch batch;
+        string name, read;
+        bool more = true;
+        while (more) {
+            window.waitToStart(number);
+            batch.number = number++;
+            batch.names.clear();
+            batch.reads.clear();
+            while (batch.reads.size() < batchSize && (more = reader.next(name, read))) {
+                batch.names.push_back(name);
+                batch.reads.push_back(read);
+            }
+            if (!batch.reads.empty() && !toClassify.push(batch)) break;
+        }
+        toClassify.close();
+    });
+    
+    atomic<int> running(numThreads);
+    auto worker = [&]() {
+        ReadCounts counts;
+        counts.hits.assign(m_sequences.size(), 0);
+        counts.lastKmer.assign(m_sequences.size(), -1);
+        Batch batch;
+        while (toClassify.pop(batch)) {
+            batch.assignments.resize(batch.reads.size());
+            for (size_t r = 0; r < batch.reads.size(); ++r) {
+                batch.assignments[r].readName.swap(batch.names[r]);
+                assignRead(batch.reads[r].data(), static_cast<int>(batch.reads[r].size()),
+                           counts, batch.assignments[r]);
+            }
+            if (!toWrite.push(std::move(batch))) break;
+        }
+        if (--running == 0) toWrite.close();
+    };
+    vector<thread> workers;
+    for (int t = 0; t < numThreads; ++t)
+        workers.push_back(thread(worker));
+    
+    // batches finish out of order, so hold on to the early ones until it is their turn
+    unordered_map<long long, Batch> waiting;
+    long long nextBatch = 0;
+    Batch batch;
+    string line;
+    while (toWrite.pop(batch)) {
+        waiting[batch.number] = std::move(batch);
+        for (auto it = waiting.find(nextBatch); it != waiting.end(); it = waiting.find(++nextBatch)) {
+            for (auto a = it->second.assignments.begin(); a != it->second.assignments.end(); ++a) {
+                line = a->readName;
+                line += '\t';
+                line += a->genomeName.empty() ? "*" : a->genomeName;
+                line += '\t';
+                line += to_string(a->hits);
+                line += a->ambiguous ? "\t1\n" : "\t0\n";
+                output << line;
+            }
+            readsClassified += it->second.assignments.size();
+            waiting.erase(it);
+            window.handled();
+        }
+    }
+    readerThread.join();
+    for (auto it = workers.begin(); it != workers.end(); ++it)
+        it->join();
+    return !reader.bad() && static_cast<bool>(output.flush());
+}
+
 //******************** GenomeMatcher functions ********************************
 
 // These functions simply delegate to GenomeMatcherImpl's functions.
 // You probably don't want to change any of this code.
 
-GenomeMatcher::GenomeMatcher(int minSearchLength)
+GenomeMatcher::GenomeMatcher(int minSearchLength, IndexKind index, const IndexOptions& options)
 {
-    m_impl = new GenomeMatcherImpl(minSearchLength);
+    m_impl = new GenomeMatcherImpl(minSearchLength, index, options);
 }
 
 GenomeMatcher::~GenomeMatcher()
@@ -210,9 +1606,19 @@ GenomeMatcher::~GenomeMatcher()
     delete m_impl;
 }
 
-void GenomeMatcher::addGenome(const Genome& genome)
+bool GenomeMatcher::addGenome(const Genome& genome)
+{
+    return m_impl->addGenome(genome);
+}
+
+void GenomeMatcher::addFirstBases(const string& bases)
 {
-    m_impl->addGenome(genome);
+    m_impl->addFirstBases(bases);
+}
+
+string GenomeMatcher::firstBases() const
+{
+    return m_impl->firstBases();
 }
 
 int GenomeMatcher::minimumSearchLength() const
@@ -220,12 +1626,57 @@ int GenomeMatcher::minimumSearchLength() const
     return m_impl->minimumSearchLength();
 }
 
+IndexKind GenomeMatcher::indexKind() const
+{
+    return m_impl->indexKind();
+}
+
+QueryStats GenomeMatcher::queryStats() const
+{
+    return m_impl->queryStats();
+}
+
+void GenomeMatcher::resetQueryStats()
+{
+    m_impl->resetQueryStats();
+}
+
 bool GenomeMatcher::findGenomesWithThisDNA(const string& fragment, int minimumLength, bool exactMatchOnly, vector<DNAMatch>& matches) const
 {
     return m_impl->findGenomesWithThisDNA(fragment, minimumLength, exactMatchOnly, matches);
 }
 
+int GenomeMatcher::enumerateDNAMatches(const string& fragment, int minimumLength, bool exactMatchOnly, const DNAMatchCallback& callback, int maxMatchesPerGenome) const
+{
+    return m_impl->enumerateDNAMatches(fragment, minimumLength, exactMatchOnly, callback, maxMatchesPerGenome);
+}
+
+bool GenomeMatcher::findGenomesWithSimilarDNA(const string& fragment, int minimumLength, int maxEdits, bool allowIndels, vector<DNAMatch>& matches) const
+{
+    return m_impl->findGenomesWithSimilarDNA(fragment, minimumLength, maxEdits, allowIndels, matches);
+}
+
 bool GenomeMatcher::findRelatedGenomes(const Genome& query, int fragmentMatchLength, bool exactMatchOnly, double matchPercentThreshold, vector<GenomeMatch>& results) const
 {
     return m_impl->findRelatedGenomes(query, fragmentMatchLength, exactMatchOnly, matchPercentThreshold, results);
 }
+
+bool GenomeMatcher::computeSimilarityMatrix(int fragmentMatchLength, bool exactMatchOnly, const string& outputFile, bool sparse, const ProgressCallback& progress) const
+{
+    return m_impl->computeSimilarityMatrix(fragmentMatchLength, exactMatchOnly, outputFile, sparse, progress);
+}
+
+bool GenomeMatcher::findRelatedGenomesByKmers(const Genome& query, int fragmentMatchLength, double matchPercentThreshold, vector<GenomeSimilarity>& results) const
+{
+    return m_impl->findRelatedGenomesByKmers(query, fragmentMatchLength, matchPercentThreshold, results);
+}
+
+bool GenomeMatcher::classifyRead(const string& read, ReadAssignment& assignment) const
+{
+    return m_impl->classifyRead(read, assignment);
+}
+
+bool GenomeMatcher::classifyReads(const string& readsFile, const string& outputFile, long long& readsClassified, int numThreads) const
+{
+    return m_impl->classifyReads(readsFile, outputFile, readsClassified, numThreads);
+}
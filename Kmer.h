@@ -0,0 +1,88 @@
+// Jong Hoon Kim
+// CS32 - Project 4
+
+#ifndef KMER_INCLUDED
+#define KMER_INCLUDED
+
+#include <cstdint>
+
+// Longest k-mer that fits into a 64 bit key with 2 bits per base
+const int MAX_ENCODED_KMER_LENGTH = 32;
+
+// Pre-condition: a base character
+// Post-condition: returns the 2 bit code of the base (A=0, C=1, G=2, T=3), or -1 for
+//                 any other character such as N
+inline int encodeBase(char base)
+{
+    switch (base) {
+        case 'A': return 0;
+        case 'C': return 1;
+        case 'G': return 2;
+        case 'T': return 3;
+        default:  return -1;
+    }
+}
+
+
+// Pre-condition: pointer to a k-mer of length k, and a key to store the result
+// Post-condition: store the k-mer's key and returns true, or returns false if it contains
+//                 an unencodable base. up to MAX_ENCODED_KMER_LENGTH the key is the 2 bit
+//                 code, the same one KmerRoller gives. longer k-mers are hashed into a key
+inline bool encodeKmer(const char* kmer, int k, uint64_t& key)
+{
+    key = k <= MAX_ENCODED_KMER_LENGTH ? 0 : 0xcbf29ce484222325ULL;
+    for (int i = 0; i < k; ++i) {
+        int code = encodeBase(kmer[i]);
+        if (code < 0) return false;
+        if (k <= MAX_ENCODED_KMER_LENGTH) key = (key << 2) | static_cast<uint64_t>(code);
+        else key = (key ^ static_cast<uint64_t>(code)) * 0x100000001b3ULL;
+    }
+    return true;
+}
+
+class KmerRoller
+{
+public:
+    // Constructor
+    //
+    // Pre-condition: k-mer length between 1 and MAX_ENCODED_KMER_LENGTH
+    // Post-condition: create a roller with no bases pushed yet
+    KmerRoller(int k)
+        : m_mask(k >= MAX_ENCODED_KMER_LENGTH ? ~uint64_t(0) : (uint64_t(1) << (2 * k)) - 1),
+          m_k(k), m_code(0), m_valid(0) { }
+    
+    // Mutator Functions
+    //
+    // Pre-condition: N/A
+    // Post-condition: forget every base pushed so far
+    void reset() { m_code = 0; m_valid = 0; }
+    //
+    // Pre-condition: next base of the sequence
+    // Post-condition: shift the base into the code and returns true if the last k bases
+    //                 form a k-mer without any unencodable base
+    bool push(char base)
+    {
+        int code = encodeBase(base);
+        if (code < 0) {
+            m_valid = 0;
+            return false;
+        }
+        m_code = ((m_code << 2) | static_cast<uint64_t>(code)) & m_mask;
+        if (m_valid < m_k) ++m_valid;
+        return m_valid == m_k;
+    }
+    
+    // Accessor Function
+    //
+    // Pre-condition: push returned true for the last base
+    // Post-condition: returns the code of the last k bases
+    uint64_t code() const { return m_code; }
+    
+private:
+    uint64_t m_mask;
+    int m_k;
+    uint64_t m_code;
+    int m_valid;
+};
+
+#endif // KMER_INCLUDED
@@ -0,0 +1,413 @@
+// Jong Hoon Kim
+// CS32 - Project 4
+
+#ifndef KMERTABLE_INCLUDED
+#define KMERTABLE_INCLUDED
+
+#include "MappedFile.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <cstdio>
+
+
+template<typename ValueType>
+class KmerTable
+{
+public:
+    // Constructor
+    //
+    // Pre-condition: Only default constructor can be called
+    // Post-condition: Create an empty table
+    KmerTable();
+
+    // Mutator Functions
+    //
+    // Pre-condition: N/A
+    // Post-condition: remove every key, value, and staged entry
+    void reset();
+    //
+    // Pre-condition: encoded k-mer and a value to be stored with it
+    // Post-condition: stage the pair. it becomes visible to find after the next build
+    void insert(uint64_t key, const ValueType& value);
+    //
+    // Pre-condition: encoded k-mer
+    // Post-condition: stage the key to be over the limit after the next build no matter how
+    //                 many values it has
+    void stopList(uint64_t key);
+    //
+    // Pre-condition: maximum number of values a key may hold (0 for no limit)
+    // Post-condition: group the staged pairs by key into one contiguous array of values
+    //                 (values of a key keep their insertion order) and index each key with
+    //                 an open addressing hash table pointing into that array. keys with more
+    //                 values than the limit are kept without their values
+    void build(size_t maxValuesPerKey = 0);
+    //
+    // Pre-condition: path prefix for the table's files, a generator, the value limit as in
+    //                build, and bytes of values to keep in memory. the generator is called
+    //                twice and has to pass the same keys, values, and stop-listed keys in the
+    //                same order to the insert and stop-list functions it is given
+    // Post-condition: same table as build, but the slots and values live in memory-mapped
+    //                 files path.slots and path.values, so they are paged in on demand rather
+    //                 than held in memory. the first call counts values per key in a slot file
+    //                 that doubles as keys arrive, the second writes each value into place.
+    //                 the values of the keys with the most values are kept in memory instead,
+    //                 as many as fit in hotBytes. returns false if the files can't be mapped
+    typedef std::function<void(uint64_t, const ValueType&)> InsertFunction;
+    typedef std::function<void(uint64_t)> StopListFunction;
+    bool buildMapped(const std::string& path,
+                     const std::function<void(const InsertFunction&, const StopListFunction&)>& generate,
+                     size_t maxValuesPerKey = 0, size_t hotBytes = 0);
+
+    // Accessor Functions
+    //
+    // Pre-condition: encoded k-mer to search
+    // Post-condition: returns the number of values stored with the key and points first at
+    //                 the first of them, or returns -1 if the key was over the limit
+    int find(uint64_t key, const ValueType*& first) const;
+    //
+    // Pre-condition: encoded k-mer that will be searched soon
+    // Post-condition: start loading the key's first slot into cache without waiting for it
+    void prefetch(uint64_t key) const;
+    //
+    // Pre-condition: encoded k-mer that will be searched soon
+    // Post-condition: for a mapped table, ask the kernel to start reading the key's values
+    //                 from disk. does nothing for a table in memory
+    void willNeed(uint64_t key) const;
+    //
+    // Pre-condition: N/A
+    // Post-condition: returns the number of distinct keys in the table
+    size_t keyCount() const;
+
+      // C++11 syntax for preventing copying and assignment
+    KmerTable(const KmerTable&) = delete;
+    KmerTable& operator=(const KmerTable&) = delete;
+private:
+    // a slot with count 0 is empty, since every key value including 0 is a valid k-mer.
+    // a key over the limit has its offset set to OVER_LIMIT. offsets are 64 bits wide so
+    // that a table of more than 4G values can't wrap into it. a mapped table marks the
+    // offsets into m_hotValues with HOT
+    static const uint64_t OVER_LIMIT = ~uint64_t(0);
+    static const uint64_t HOT = uint64_t(1) << 63;
+    struct Slot {
+        uint64_t key;
+        uint64_t offset;
+        uint64_t count;
+    };
+
+    std::vector<Slot> m_slots;
+    std::vector<ValueType> m_values;
+    std::vector<ValueType> m_hotValues;
+    MappedFile m_slotFile;
+    MappedFile m_valueFile;
+    const Slot* m_slotData;        // points into m_slots or m_slotFile
+    const ValueType* m_valueData;  // points into m_values or m_valueFile
+    std::vector<std::pair<uint64_t, ValueType>> m_staged;
+    std::vector<uint64_t> m_stopListed;
+    uint64_t m_mask;
+    size_t m_keyCount;
+
+    // helper functions
+    //
+    // Pre-condition: encoded k-mer
+    // Post-condition: returns a well mixed hash of the key (murmur3 finalizer) so that
+    //                 k-mers sharing a prefix don't cluster in the table
+    static uint64_t mix(uint64_t key);
+    //
+    // Pre-condition: encoded k-mer
+    // Post-condition: returns the slot holding the key, or nullptr if it isn't in the table
+    const Slot* findSlot(uint64_t key) const;
+};
+
+
+template<typename ValueType>
+KmerTable<ValueType>::KmerTable()
+     : m_slotData(nullptr), m_valueData(nullptr), m_mask(0), m_keyCount(0) { }
+
+
+template<typename ValueType>
+void KmerTable<ValueType>::reset()
+{
+    std::vector<Slot>().swap(m_slots);
+    std::vector<ValueType>().swap(m_values);
+    std::vector<ValueType>().swap(m_hotValues);
+    std::vector<std::pair<uint64_t, ValueType>>().swap(m_staged);
+    std::vector<uint64_t>().swap(m_stopListed);
+    m_slotFile.unmap();
+    m_valueFile.unmap();
+    m_slotData = nullptr;
+    m_valueData = nullptr;
+    m_mask = 0;
+    m_keyCount = 0;
+}
+
+
+template<typename ValueType>
+void KmerTable<ValueType>::insert(uint64_t key, const ValueType& value)
+{ m_staged.push_back(std::make_pair(key, value)); }
+
+
+template<typename ValueType>
+void KmerTable<ValueType>::stopList(uint64_t key)
+{ m_stopListed.push_back(key); }
+
+
+template<typename ValueType>
+void KmerTable<ValueType>::build(size_t maxValuesPerKey)
+{
+    m_slotFile.unmap();
+    m_valueFile.unmap();
+
+    // sort staged pairs by key only, keeping the insertion order of values within a key
+    std::stable_sort(m_staged.begin(), m_staged.end(),
+                     [](const std::pair<uint64_t, ValueType>& a,
+                        const std::pair<uint64_t, ValueType>& b) { return a.first < b.first; });
+
+    std::sort(m_stopListed.begin(), m_stopListed.end());
+    m_stopListed.erase(std::unique(m_stopListed.begin(), m_stopListed.end()), m_stopListed.end());
+
+    size_t keys = m_stopListed.size();
+    for (size_t i = 0; i < m_staged.size(); ++i)
+        if (i == 0 || m_staged[i].first != m_staged[i - 1].first) ++keys;
+
+    // keep the load factor at or below one half so probe sequences stay short
+    size_t capacity = 16;
+    while (capacity < 2 * keys) capacity *= 2;
+    m_slots.assign(capacity, Slot());
+    for (auto it = m_slots.begin(); it != m_slots.end(); ++it) it->count = 0;
+    m_mask = capacity - 1;
+
+    // copy values into one contiguous array and point a slot at each run of equal keys
+    m_values.clear();
+    m_values.reserve(m_staged.size());
+    size_t i = 0;
+    while (i < m_staged.size()) {
+        const uint64_t key = m_staged[i].first;
+        const size_t begin = m_values.size();
+        for (; i < m_staged.size() && m_staged[i].first == key; ++i)
+            m_values.push_back(m_staged[i].second);
+        uint64_t slot = mix(key) & m_mask;
+        while (m_slots[slot].count != 0) slot = (slot + 1) & m_mask;
+        m_slots[slot].key    = key;
+        m_slots[slot].offset = begin;
+        m_slots[slot].count  = m_values.size() - begin;
+        if ((maxValuesPerKey > 0 && m_values.size() - begin > maxValuesPerKey) ||
+            std::binary_search(m_stopListed.begin(), m_stopListed.end(), key)) {
+            m_values.resize(begin);
+            m_slots[slot].offset = OVER_LIMIT;
+        }
+    }
+
+    // stop-listed keys without any values still get a slot so find reports them
+    for (auto it = m_stopListed.begin(); it != m_stopListed.end(); ++it) {
+        uint64_t slot = mix(*it) & m_mask;
+        while (m_slots[slot].count != 0 && m_slots[slot].key != *it) slot = (slot + 1) & m_mask;
+        if (m_slots[slot].count != 0) continue;
+        m_slots[slot].key    = *it;
+        m_slots[slot].offset = OVER_LIMIT;
+        m_slots[slot].count  = 1;
+    }
+    m_keyCount = 0;
+    for (auto it = m_slots.begin(); it != m_slots.end(); ++it)
+        if (it->count != 0) ++m_keyCount;
+    std::vector<std::pair<uint64_t, ValueType>>().swap(m_staged);
+    std::vector<uint64_t>().swap(m_stopListed);
+    m_slotData = m_slots.data();
+    m_valueData = m_values.data();
+}
+
+
+template<typename ValueType>
+bool KmerTable<ValueType>::buildMapped(const std::string& path,
+                                       const std::function<void(const InsertFunction&, const StopListFunction&)>& generate,
+                                       size_t maxValuesPerKey, size_t hotBytes)
+{
+    reset();
+    size_t capacity = 16;
+    if (!m_slotFile.map(path + ".slots", capacity * sizeof(Slot), true)) return false;
+    Slot* slots = reinterpret_cast<Slot*>(m_slotFile.data());
+    m_mask = capacity - 1;
+    bool failed = false;
+
+    // new file pages are zero filled, so every slot starts empty
+    auto locate = [&](uint64_t key) -> Slot& {
+        uint64_t slot = mix(key) & m_mask;
+        while (slots[slot].count != 0 && slots[slot].key != key) slot = (slot + 1) & m_mask;
+        return slots[slot];
+    };
+
+    // keep the load factor at or below one half, same as build, by moving the slots into a
+    // file twice the size whenever a new key would go over it. the new file replaces the old
+    // one under its name, so the table ends up sized by its distinct keys
+    auto makeRoom = [&]() -> bool {
+        if (2 * (m_keyCount + 1) <= capacity) return true;
+        MappedFile grown;
+        if (!grown.map(path + ".slots.grown", 2 * capacity * sizeof(Slot), true)) return false;
+        Slot* old = slots;
+        slots = reinterpret_cast<Slot*>(grown.data());
+        m_mask = 2 * capacity - 1;
+        for (size_t i = 0; i < capacity; ++i)
+            if (old[i].count != 0) locate(old[i].key) = old[i];
+        capacity *= 2;
+        m_slotFile.swap(grown);
+        return std::rename((path + ".slots.grown").c_str(), (path + ".slots").c_str()) == 0;
+    };
+
+    // first pass: count the values of each key. a stop-listed key takes a slot even without
+    // values and is remembered by an OVER_LIMIT offset
+    auto add = [&](uint64_t key) -> Slot* {
+        Slot* slot = &locate(key);
+        if (slot->count != 0) return slot;
+        if (failed || !makeRoom()) {
+            failed = true;
+            return nullptr;
+        }
+        slot = &locate(key);
+        slot->key = key;
+        m_keyCount++;
+        return slot;
+    };
+    generate([&](uint64_t key, const ValueType&) {
+                 Slot* slot = add(key);
+                 if (slot != nullptr) slot->count++;
+             },
+             [&](uint64_t key) {
+                 Slot* slot = add(key);
+                 if (slot == nullptr) return;
+                 if (slot->count == 0) slot->count = 1;
+                 slot->offset = OVER_LIMIT;
+             });
+    if (failed) {
+        reset();
+        return false;
+    }
+
+    // the keys with the most values are the ones most seeds of the library land on. find
+    // the fewest values a key needs to be kept in memory so that those keys fit in hotBytes
+    std::map<uint64_t, uint64_t> keysWithCount;
+    for (size_t i = 0; i < capacity; ++i) {
+        if (slots[i].count == 0 || slots[i].offset == OVER_LIMIT) continue;
+        if (maxValuesPerKey > 0 && slots[i].count > maxValuesPerKey)
+            slots[i].offset = OVER_LIMIT;
+        else
+            keysWithCount[slots[i].count]++;
+    }
+    uint64_t hotCount = UINT64_MAX;
+    uint64_t hotTotal = 0;
+    for (auto it = keysWithCount.rbegin(); it != keysWithCount.rend(); ++it) {
+        if ((hotTotal + it->first * it->second) * sizeof(ValueType) > hotBytes) break;
+        hotTotal += it->first * it->second;
+        hotCount = it->first;
+    }
+
+    // give each key that keeps its values a run in memory or in the value file, in slot order
+    uint64_t total = 0;
+    uint64_t hot = 0;
+    for (size_t i = 0; i < capacity; ++i) {
+        if (slots[i].count == 0 || slots[i].offset == OVER_LIMIT) continue;
+        if (slots[i].count >= hotCount) {
+            slots[i].offset = hot | HOT;
+            hot += slots[i].count;
+        }
+        else {
+            slots[i].offset = total;
+            total += slots[i].count;
+        }
+    }
+    m_hotValues.resize(hot);
+    if (!m_valueFile.map(path + ".values", total * sizeof(ValueType), true)) {
+        reset();
+        return false;
+    }
+    ValueType* values = reinterpret_cast<ValueType*>(m_valueFile.data());
+
+    // second pass: write each value at the end of its key's run so far, which keeps the
+    // values of a key in insertion order. then move each offset back to the start of its run
+    generate([&](uint64_t key, const ValueType& value) {
+                 Slot& slot = locate(key);
+                 if (slot.offset == OVER_LIMIT) return;
+                 if (slot.offset & HOT) m_hotValues[(slot.offset++) & ~HOT] = value;
+                 else                   values[slot.offset++] = value;
+             },
+             [](uint64_t) { });
+    for (size_t i = 0; i < capacity; ++i)
+        if (slots[i].count != 0 && slots[i].offset != OVER_LIMIT)
+            slots[i].offset -= slots[i].count;
+
+    // lookups probe one slot and read one run of values at a random place, so readahead
+    // would only evict pages other lookups need
+    m_slotFile.advise(0, m_slotFile.size(), MADV_RANDOM);
+    m_valueFile.advise(0, m_valueFile.size(), MADV_RANDOM);
+    m_slotData = slots;
+    m_valueData = values;
+    return true;
+}
+
+
+template<typename ValueType>
+int KmerTable<ValueType>::find(uint64_t key, const ValueType*& first) const
+{
+    first = nullptr;
+    const Slot* slot = findSlot(key);
+    if (slot == nullptr) return 0;
+    if (slot->offset == OVER_LIMIT) return -1;
+    first = (slot->offset & HOT) ? m_hotValues.data() + (slot->offset & ~HOT)
+                                 : m_valueData + slot->offset;
+    return static_cast<int>(slot->count);
+}
+
+
+template<typename ValueType>
+typename KmerTable<ValueType>::Slot const* KmerTable<ValueType>::findSlot(uint64_t key) const
+{
+    // linear probing until the key or an empty slot is found
+    if (m_slotData == nullptr) return nullptr;
+    uint64_t slot = mix(key) & m_mask;
+    while (m_slotData[slot].count != 0) {
+        if (m_slotData[slot].key == key) return &m_slotData[slot];
+        slot = (slot + 1) & m_mask;
+    }
+    return nullptr;
+}
+
+
+template<typename ValueType>
+void KmerTable<ValueType>::prefetch(uint64_t key) const
+{
+    if (m_slotData != nullptr)
+        __builtin_prefetch(&m_slotData[mix(key) & m_mask]);
+}
+
+
+template<typename ValueType>
+void KmerTable<ValueType>::willNeed(uint64_t key) const
+{
+    if (m_valueFile.data() == nullptr) return;
+    const Slot* slot = findSlot(key);
+    if (slot != nullptr && slot->offset != OVER_LIMIT && !(slot->offset & HOT))
+        m_valueFile.advise(slot->offset * sizeof(ValueType), slot->count * sizeof(ValueType),
+                           MADV_WILLNEED);
+}
+
+
+template<typename ValueType>
+size_t KmerTable<ValueType>::keyCount() const
+{ return m_keyCount; }
+
+
+template<typename ValueType>
+uint64_t KmerTable<ValueType>::mix(uint64_t key)
+{
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ULL;
+    key ^= key >> 33;
+    return key;
+}
+
+#endif // KMERTABLE_INCLUDED
@@ -0,0 +1,141 @@
+// Jong Hoon Kim
+// CS32 - Project 4
+
+#ifndef LRUCACHE_INCLUDED
+#define LRUCACHE_INCLUDED
+
+#include <list>
+#include <algorithm>
+#include <iterator>
+#include <unordered_map>
+#include <vector>
+#include <functional>
+#include <mutex>
+#include <cstddef>
+
+
+template<typename KeyType, typename ValueType>
+class LRUCache
+{
+public:
+    // Constructor
+    //
+    // Pre-condition: maximum number of entries (0 keeps nothing) and of bytes the entries
+    //                may hold (0 for no limit)
+    // Post-condition: Create an empty cache
+    explicit LRUCache(size_t capacity, size_t maxBytes = 0)
+        : m_capacity(capacity), m_maxBytes(maxBytes), m_bytes(0), m_seenAny(false)
+    {
+        if (capacity == 0) return;
+        size_t seen = 1;
+        while (seen < 2 * std::min(capacity, static_cast<size_t>(1) << 20)) seen <<= 1;
+        m_seen.assign(seen, 0);
+        m_index.reserve(std::min(capacity, static_cast<size_t>(1) << 20));
+    }
+
+    // Mutator Functions
+    //
+    // Pre-condition: key and a function taking its value and returning whether it is the
+    //                one wanted
+    // Post-condition: call the function with the key's value while the cache is locked. if it
+    //                 returns true, make the key the most recently used one and returns true.
+    //                 returns false if the key isn't cached or the function returned false
+    template<typename Reader>
+    bool find(const KeyType& key, Reader reader)
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        auto it = m_index.find(key);
+        if (it == m_index.end() || !reader(static_cast<const ValueType&>(it->second->value)))
+            return false;
+        m_entries.splice(m_entries.begin(), m_entries, it->second);
+        return true;
+    }
+    //
+    // Pre-condition: key, the bytes its value holds, and a function storing the value into
+    //                the one it is given
+    // Post-condition: store the value as the most recently used entry, replacing any value the
+    //                 key had. the least recently used entries are dropped until the new one
+    //                 fits both limits, and a value larger than the byte limit isn't stored.
+    //                 a key is only stored the second time it is inserted, so that keys seen
+    //                 once cost a single probe of a table of recent hashes instead of pushing
+    //                 out the ones that repeat
+    template<typename Writer>
+    void insert(const KeyType& key, size_t bytes, Writer writer)
+    {
+        if (m_capacity == 0 || (m_maxBytes > 0 && bytes > m_maxBytes)) return;
+        std::lock_guard<std::mutex> guard(m_lock);
+        const size_t hash = std::hash<KeyType>()(key) | 1;
+        size_t& seen = m_seen[hash & (m_seen.size() - 1)];
+        if (seen != hash) {
+            seen = hash;
+            m_seenAny = true;
+            return;
+        }
+        auto it = m_index.find(key);
+        if (it != m_index.end()) {
+            m_bytes -= it->second->bytes;
+            m_entries.erase(it->second);
+            m_index.erase(it);
+        }
+        while (!m_entries.empty() && m_maxBytes > 0 && m_bytes + bytes > m_maxBytes) {
+            m_bytes -= m_entries.back().bytes;
+            m_index.erase(m_entries.back().key);
+            m_entries.pop_back();
+        }
+        
+        // a full cache reuses its least recently used entry, whose buffers the value is
+        // written into, so that a cache under steady misses doesn't allocate for every one
+        if (m_entries.size() >= m_capacity) {
+            m_bytes -= m_entries.back().bytes;
+            m_index.erase(m_entries.back().key);
+            m_entries.splice(m_entries.begin(), m_entries, std::prev(m_entries.end()));
+        }
+        else m_entries.emplace_front();
+        Entry& entry = m_entries.front();
+        entry.key   = key;
+        entry.bytes = bytes;
+        writer(entry.value);
+        m_index[key] = m_entries.begin();
+        m_bytes += bytes;
+    }
+    //
+    // Pre-condition: N/A
+    // Post-condition: drop every entry
+    void clear()
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        if (m_seenAny) std::fill(m_seen.begin(), m_seen.end(), 0);
+        m_seenAny = false;
+        m_entries.clear();
+        m_index.clear();
+        m_bytes = 0;
+    }
+
+    // Accessor Functions
+    //
+    // Pre-condition: N/A
+    // Post-condition: returns the maximum number of entries
+    size_t capacity() const { return m_capacity; }
+
+      // C++11 syntax for preventing copying and assignment
+    LRUCache(const LRUCache&) = delete;
+    LRUCache& operator=(const LRUCache&) = delete;
+private:
+    struct Entry {
+        KeyType key;
+        ValueType value;
+        size_t bytes;
+    };
+    typedef std::list<Entry> EntryList;
+
+    EntryList m_entries;   // most recently used first
+    std::unordered_map<KeyType, typename EntryList::iterator> m_index;
+    size_t m_capacity;
+    size_t m_maxBytes;
+    size_t m_bytes;        // held by the entries
+    std::vector<size_t> m_seen;   // hash of the last key inserted into each slot, 0 for none
+    bool m_seenAny;               // some slot isn't 0
+    std::mutex m_lock;
+};
+
+#endif // LRUCACHE_INCLUDED
@@ -0,0 +1,102 @@
+// Jong Hoon Kim
+// CS32 - Project 4
+
+#ifndef MAPPEDFILE_INCLUDED
+#define MAPPEDFILE_INCLUDED
+
+#include <string>
+#include <cstddef>
+#include <utility>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+
+class MappedFile
+{
+public:
+    // Constructor
+    //
+    // Pre-condition: Only default constructor can be called
+    // Post-condition: Create an object with nothing mapped
+    MappedFile() : m_data(nullptr), m_size(0) { }
+
+    // Destructor
+    //
+    // Pre-condition: N/A
+    // Post-condition: unmap the file if one is mapped
+    ~MappedFile() { unmap(); }
+
+    // Mutator Functions
+    //
+    // Pre-condition: file path, size in bytes, and whether to create the file
+    // Post-condition: map the first size bytes of the file. a created file is truncated to
+    //                 size (zero filled) and mapped writable, otherwise the existing file is
+    //                 mapped read only. returns false if the file can't be opened or mapped
+    bool map(const std::string& path, size_t size, bool create)
+    {
+        unmap();
+        if (size == 0) return true;
+        int fd = ::open(path.c_str(), create ? (O_RDWR | O_CREAT | O_TRUNC) : O_RDONLY, 0644);
+        if (fd < 0) return false;
+        if (create && ::ftruncate(fd, static_cast<off_t>(size)) != 0) {
+            ::close(fd);
+            return false;
+        }
+        void* data = ::mmap(nullptr, size, create ? (PROT_READ | PROT_WRITE) : PROT_READ,
+                            MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (data == MAP_FAILED) return false;
+        m_data = static_cast<char*>(data);
+        m_size = size;
+        return true;
+    }
+    //
+    // Pre-condition: N/A
+    // Post-condition: unmap the file. data written through a writable mapping stays in it
+    void unmap()
+    {
+        if (m_data != nullptr) ::munmap(m_data, m_size);
+        m_data = nullptr;
+        m_size = 0;
+    }
+    //
+    // Pre-condition: another MappedFile
+    // Post-condition: exchange the mappings of the two objects
+    void swap(MappedFile& other)
+    {
+        std::swap(m_data, other.m_data);
+        std::swap(m_size, other.m_size);
+    }
+
+    // Accessor Functions
+    //
+    // Pre-condition: N/A
+    // Post-condition: returns the start of the mapping, or nullptr if nothing is mapped
+    char* data() const { return m_data; }
+    //
+    // Pre-condition: N/A
+    // Post-condition: returns the size of the mapping in bytes
+    size_t size() const { return m_size; }
+    //
+    // Pre-condition: byte range within the mapping and an madvise advice (MADV_RANDOM,
+    //                MADV_WILLNEED, ...)
+    // Post-condition: pass the advice for the pages covering the range to the kernel
+    void advise(size_t offset, size_t length, int advice) const
+    {
+        if (m_data == nullptr || length == 0 || offset >= m_size) return;
+        static const size_t pageSize = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+        size_t begin = offset / pageSize * pageSize;
+        size_t end = offset + length < m_size ? offset + length : m_size;
+        ::madvise(m_data + begin, end - begin, advice);
+    }
+
+      // C++11 syntax for preventing copying and assignment
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+private:
+    char* m_data;
+    size_t m_size;
+};
+
+#endif // MAPPEDFILE_INCLUDED
@@ -0,0 +1,53 @@
+// Jong Hoon Kim
+// CS32 - Project 4
+
+#ifndef REORDERWINDOW_INCLUDED
+#define REORDERWINDOW_INCLUDED
+
+#include <mutex>
+#include <condition_variable>
+
+
+// Items numbered 0, 1, 2, ... are started in order, may finish out of order, and are
+// handled in order, so the ones finished early are held back. The window keeps an item
+// from starting until the one size items before it has been handled, which bounds how many
+// are held back however slow one of them is.
+class ReorderWindow
+{
+public:
+    // Constructor
+    //
+    // Pre-condition: number of items that may be started but not handled yet (at least 1)
+    // Post-condition: Create a window where no item has been handled
+    explicit ReorderWindow(long long size) : m_size(size > 0 ? size : 1), m_handled(0) { }
+
+    // Mutator Functions
+    //
+    // Pre-condition: number of the next item to start
+    // Post-condition: wait until fewer than size items before it are unhandled
+    void waitToStart(long long number)
+    {
+        std::unique_lock<std::mutex> lock(m_lock);
+        m_slotFree.wait(lock, [&] { return number < m_handled + m_size; });
+    }
+    //
+    // Pre-condition: the next item in order has been handled
+    // Post-condition: let the item size after it start
+    void handled()
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        m_handled++;
+        m_slotFree.notify_all();
+    }
+
+      // C++11 syntax for preventing copying and assignment
+    ReorderWindow(const ReorderWindow&) = delete;
+    ReorderWindow& operator=(const ReorderWindow&) = delete;
+private:
+    long long m_size;
+    long long m_handled;
+    std::mutex m_lock;
+    std::condition_variable m_slotFree;
+};
+
+#endif // REORDERWINDOW_INCLUDED
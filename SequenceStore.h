@@ -0,0 +1,114 @@
+// Jong Hoon Kim
+// CS32 - Project 4
+
+#ifndef SEQUENCESTORE_INCLUDED
+#define SEQUENCESTORE_INCLUDED
+
+#include "MappedFile.h"
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cerrno>
+
+
+class SequenceStore
+{
+public:
+    // Constructor
+    //
+    // Pre-condition: Only default constructor can be called
+    // Post-condition: Create an empty store that keeps sequences in memory
+    SequenceStore() : m_fd(-1), m_fileSize(0) { }
+
+    // Destructor
+    //
+    // Pre-condition: N/A
+    // Post-condition: close the backing file if there is one
+    ~SequenceStore() { if (m_fd >= 0) ::close(m_fd); }
+
+    // Mutator Functions
+    //
+    // Pre-condition: path of a file to create, before any sequence is added
+    // Post-condition: keep sequences in the file from now on and returns true, or keep them in
+    //                 memory and returns false if the file can't be created
+    bool useFile(const std::string& path)
+    {
+        m_fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        m_path = path;
+        return m_fd >= 0;
+    }
+    //
+    // Pre-condition: sequence to add
+    // Post-condition: append the sequence and returns true. with a backing file it is readable
+    //                 after the next refresh, and if it can't be written the store is left as
+    //                 it was and returns false
+    bool add(const std::string& sequence)
+    {
+        if (m_fd < 0) {
+            m_sequences.push_back(sequence);
+            m_lengths.push_back(static_cast<int>(sequence.size()));
+            return true;
+        }
+        size_t written = 0;
+        while (written < sequence.size()) {
+            ssize_t n = ::pwrite(m_fd, sequence.data() + written, sequence.size() - written,
+                                 static_cast<off_t>(m_fileSize + written));
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            written += static_cast<size_t>(n);
+        }
+        m_offsets.push_back(m_fileSize);
+        m_lengths.push_back(static_cast<int>(sequence.size()));
+        m_fileSize += sequence.size();
+        return true;
+    }
+    //
+    // Pre-condition: N/A
+    // Post-condition: map the backing file again if sequences were added since it was mapped.
+    //                 extensions read sequences at random positions, so readahead is turned off
+    void refresh()
+    {
+        if (m_fd < 0 || m_map.size() == m_fileSize) return;
+        m_map.map(m_path, m_fileSize, false);
+        m_map.advise(0, m_fileSize, MADV_RANDOM);
+    }
+
+    // Accessor Functions
+    //
+    // Pre-condition: N/A
+    // Post-condition: returns the number of sequences
+    int size() const { return static_cast<int>(m_lengths.size()); }
+    //
+    // Pre-condition: index of a sequence
+    // Post-condition: returns its length
+    int length(int index) const { return m_lengths[index]; }
+    //
+    // Pre-condition: index of a sequence, and refresh called since it was added
+    // Post-condition: returns a pointer to its first base
+    const char* data(int index) const
+    {
+        if (m_fd < 0) return m_sequences[index].data();
+        return m_map.data() + m_offsets[index];
+    }
+    //
+    // Pre-condition: index of a sequence, range of positions in it, and an madvise advice
+    // Post-condition: pass the advice for the range to the kernel. does nothing in memory
+    void advise(int index, int position, int length, int advice) const
+    {
+        if (m_fd >= 0) m_map.advise(m_offsets[index] + position, length, advice);
+    }
+
+      // C++11 syntax for preventing copying and assignment
+    SequenceStore(const SequenceStore&) = delete;
+    SequenceStore& operator=(const SequenceStore&) = delete;
+private:
+    std::vector<std::string> m_sequences;   // sequences kept in memory
+    std::vector<int> m_lengths;
+    std::vector<size_t> m_offsets;          // offset of each sequence in the backing file
+    std::string m_path;
+    int m_fd;
+    size_t m_fileSize;
+    MappedFile m_map;
+};
+
+#endif // SEQUENCESTORE_INCLUDED
@@ -0,0 +1,562 @@
+// Jong Hoon Kim
+// CS32 - Project 4
+
+#include "provided.h"
+#include <string>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <functional>
+#include <algorithm>
+#include <unordered_map>
+#include <cstring>
+#include <cstdint>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+using namespace std;
+
+// one end of a socket between the coordinator and a shard. messages are a 4 byte length
+// followed by the payload, which is built from ints, doubles, and length prefixed strings.
+// both ends are on the same machine so numbers are sent in their native byte order
+class ShardChannel
+{
+public:
+    // Constructor
+    //
+    // Pre-condition: connected socket descriptor
+    // Post-condition: Create a channel over it with empty buffers
+    explicit ShardChannel(int fd) : m_fd(fd), m_readPos(0) { }
+
+    // Mutator Functions
+    //
+    // Pre-condition: value to append to the outgoing message
+    // Post-condition: append it to the outgoing message
+    void putInt(int value)         { m_out.append(reinterpret_cast<const char*>(&value), sizeof(value)); }
+    void putDouble(double value)   { m_out.append(reinterpret_cast<const char*>(&value), sizeof(value)); }
+    void putString(const string& value)
+    {
+        putInt(static_cast<int>(value.size()));
+        m_out += value;
+    }
+    //
+    // Pre-condition: N/A
+    // Post-condition: send the outgoing message and clear it. returns false if the other end
+    //                 is gone
+    bool send()
+    {
+        uint32_t length = static_cast<uint32_t>(m_out.size());
+        bool ok = writeAll(reinterpret_cast<const char*>(&length), sizeof(length)) &&
+                  writeAll(m_out.data(), m_out.size());
+        m_out.clear();
+        return ok;
+    }
+    //
+    // Pre-condition: N/A
+    // Post-condition: wait for the next message and make it the one read from. returns false
+    //                 if the other end is gone
+    bool receive()
+    {
+        uint32_t length;
+        m_readPos = 0;
+        if (!readAll(reinterpret_cast<char*>(&length), sizeof(length))) return false;
+        m_in.resize(length);
+        return readAll(&m_in[0], length);
+    }
+    //
+    // Pre-condition: variable to store the value
+    // Post-condition: read the next value of the received message into it. returns false if
+    //                 the message has no more of it
+    bool getInt(int& value)       { return getRaw(&value, sizeof(value)); }
+    bool getDouble(double& value) { return getRaw(&value, sizeof(value)); }
+    bool getString(string& value)
+    {
+        int length;
+        if (!getInt(length) || length < 0 || m_readPos + length > m_in.size()) return false;
+        value.assign(m_in, m_readPos, length);
+        m_readPos += length;
+        return true;
+    }
+
+private:
+    int m_fd;
+    string m_out;
+    string m_in;
+    size_t m_readPos;
+
+    bool getRaw(void* value, size_t size)
+    {
+        if (m_readPos + size > m_in.size()) return false;
+        memcpy(value, m_in.data() + m_readPos, size);
+        m_readPos += size;
+        return true;
+    }
+    bool writeAll(const char* data, size_t size)
+    {
+        while (size > 0) {
+            ssize_t n = ::send(m_fd, data, size, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            data += n;
+            size -= static_cast<size_t>(n);
+        }
+        return true;
+    }
+    bool readAll(char* data, size_t size)
+    {
+        while (size > 0) {
+            ssize_t n = ::read(m_fd, data, size);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            data += n;
+            size -= static_cast<size_t>(n);
+        }
+        return true;
+    }
+};
+
+class ShardedGenomeMatcherImpl
+{
+public:
+    // Constructor
+    //
+    // Pre-condition: minimum search length, number of shards, kind of index, and index options
+    // Post-condition: start a worker process per shard, each with an empty GenomeMatcher made
+    //                 with the same arguments and a socket per lane. with a storage directory,
+    //                 shard i keeps its files in the subdirectory shard<i>
+    ShardedGenomeMatcherImpl(int minSearchLength, int numShards, IndexKind index,
+                             const IndexOptions& options);
+
+    // Destructor
+    //
+    // Pre-condition: N/A
+    // Post-condition: close the sockets, which makes every worker exit, and wait for them
+    ~ShardedGenomeMatcherImpl();
+
+    // Mutator Function
+    //
+    // Pre-condition: a Genome object to add
+    // Post-condition: send the genome to the shard its name hashes to, so genomes sharing a
+    //                 name always end up in the same shard. returns false if the shard
+    //                 couldn't add it or is gone
+    bool addGenome(const Genome& genome);
+
+    // Accessor Functions
+    //
+    // Pre-condition: N/A
+    // Post-condition: returns the minimum search length
+    int minimumSearchLength() const;
+    //
+    // Pre-condition: N/A
+    // Post-condition: returns the number of shards
+    int numShards() const;
+    //
+    // Pre-condition: same as GenomeMatcher::findGenomesWithThisDNA
+    // Post-condition: ask every shard, and store their matches into the vector in the order
+    //                 the genomes were added, same as a single GenomeMatcher. returns false
+    //                 if nothing was found or a worker is gone
+    bool findGenomesWithThisDNA(const string& fragment, int minimumLength,
+                                bool exactMatchOnly, vector<DNAMatch>& matches) const;
+    //
+    // Pre-condition: same as GenomeMatcher::findRelatedGenomes
+    // Post-condition: ask every shard, and store their results into the vector in the order
+    //                 the genomes were added, same as a single GenomeMatcher. returns false
+    //                 if nothing was found or a worker is gone
+    bool findRelatedGenomes(const Genome& query, int fragmentMatchLength, bool exactMatchOnly,
+                            double matchPercentThreshold, vector<GenomeMatch>& results) const;
+
+private:
+    // requests understood by a worker. every request is answered
+    enum { REQUEST_ADD = 1, REQUEST_FIND = 2, REQUEST_RELATED = 3, REQUEST_FIRST_BASES = 4 };
+
+    // holds a lane from construction to destruction, the way lock_guard holds a mutex
+    struct LaneGuard {
+        explicit LaneGuard(const ShardedGenomeMatcherImpl& impl)
+            : m_impl(impl), lane(impl.acquireLane()) { }
+        ~LaneGuard() { m_impl.releaseLane(lane); }
+        const ShardedGenomeMatcherImpl& m_impl;
+        const int lane;
+    };
+
+    int m_minSearchLength;
+    vector<pid_t> m_workers;
+    vector<int> m_fds;
+
+    // m_lanes[l][s] is lane l's socket to shard s, served by its own thread in the worker. a
+    // request holds one lane for its whole scatter-gather, so requests on different lanes
+    // are served by the shards at the same time. m_freeLanes lists the lanes nobody holds
+    mutable vector<vector<ShardChannel>> m_lanes;
+    mutable vector<int> m_freeLanes;
+    mutable mutex m_laneLock;
+    mutable condition_variable m_laneFreed;
+
+    // like GenomeMatcher, genomes can't be added while other threads query, but adds are
+    // serialized among themselves. m_firstBases is every first base any shard has, which
+    // all shards are told about so that each applies the first base rule of the library
+    mutex m_addLock;
+    unordered_map<string, int> m_genomeOrder;   // name -> order it was first added in
+    string m_firstBases;
+
+    // Helper Functions
+    //
+    // Pre-condition: sockets of every lane to the coordinator and the arguments of the
+    //                GenomeMatcher
+    // Post-condition: serve each lane from its own thread with one GenomeMatcher until the
+    //                 coordinator closes the sockets, then exit the process
+    static void serveShard(const vector<int>& fds, int minSearchLength, IndexKind index,
+                           const IndexOptions& options);
+    //
+    // Pre-condition: GenomeMatcher of the shard and socket of a lane
+    // Post-condition: serve requests on the lane until the coordinator closes it
+    static void serveLane(GenomeMatcher& matcher, int fd);
+    //
+    // Pre-condition: genome name
+    // Post-condition: returns the shard the name belongs to
+    int shardOf(const string& name) const;
+    //
+    // Pre-condition: N/A
+    // Post-condition: wait until a lane is free and returns it, taken
+    int acquireLane() const;
+    //
+    // Pre-condition: lane returned by acquireLane
+    // Post-condition: give the lane back
+    void releaseLane(int lane) const;
+    //
+    // Pre-condition: vector of results with a genomeName member
+    // Post-condition: sort the results into the order their genomes were added in
+    template<typename Result>
+    void sortByGenomeOrder(vector<Result>& results) const;
+};
+
+ShardedGenomeMatcherImpl::ShardedGenomeMatcherImpl(int minSearchLength, int numShards,
+                                                   IndexKind index, const IndexOptions& options)
+                         :m_minSearchLength(minSearchLength)
+{
+    // a lane per hardware thread, so that many callers don't leave workers idle
+    const int numLanes = max(1, min(8, static_cast<int>(thread::hardware_concurrency())));
+    m_lanes.resize(numLanes);
+    for (int s = 0; s < max(1, numShards); ++s) {
+        IndexOptions shardOptions = options;
+        if (!options.storageDirectory.empty()) {
+            shardOptions.storageDirectory = options.storageDirectory + "/shard" + to_string(s);
+            mkdir(shardOptions.storageDirectory.c_str(), 0755);
+        }
+        vector<int> ours, theirs;
+        for (int l = 0; l < numLanes; ++l) {
+            int fds[2];
+            if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) break;
+            ours.push_back(fds[0]);
+            theirs.push_back(fds[1]);
+        }
+        pid_t pid = static_cast<int>(ours.size()) == numLanes ? fork() : -1;
+        if (pid < 0) {
+            for (size_t l = 0; l < ours.size(); ++l) {
+                close(ours[l]);
+                close(theirs[l]);
+            }
+            break;
+        }
+        if (pid == 0) {
+            // the worker only keeps its own sockets, so it sees the coordinator close them
+            for (size_t l = 0; l < ours.size(); ++l)
+                close(ours[l]);
+            for (auto it = m_fds.begin(); it != m_fds.end(); ++it)
+                close(*it);
+            serveShard(theirs, minSearchLength, index, shardOptions);
+        }
+        for (int l = 0; l < numLanes; ++l) {
+            close(theirs[l]);
+            m_fds.push_back(ours[l]);
+            m_lanes[l].push_back(ShardChannel(ours[l]));
+        }
+        m_workers.push_back(pid);
+    }
+    for (int l = 0; l < numLanes; ++l)
+        m_freeLanes.push_back(l);
+}
+
+ShardedGenomeMatcherImpl::~ShardedGenomeMatcherImpl()
+{
+    for (auto it = m_fds.begin(); it != m_fds.end(); ++it)
+        close(*it);
+    for (auto it = m_workers.begin(); it != m_workers.end(); ++it)
+        waitpid(*it, nullptr, 0);
+}
+
+void ShardedGenomeMatcherImpl::serveShard(const vector<int>& fds, int minSearchLength,
+                                          IndexKind index, const IndexOptions& options)
+{
+    GenomeMatcher matcher(minSearchLength, index, options);
+    vector<thread> lanes;
+    for (size_t l = 1; l < fds.size(); ++l)
+        lanes.push_back(thread(serveLane, ref(matcher), fds[l]));
+    serveLane(matcher, fds[0]);
+    for (auto it = lanes.begin(); it != lanes.end(); ++it)
+        it->join();
+    _exit(0);
+}
+
+void ShardedGenomeMatcherImpl::serveLane(GenomeMatcher& matcher, int fd)
+{
+    ShardChannel channel(fd);
+    int request;
+    while (channel.receive() && channel.getInt(request)) {
+        if (request == REQUEST_ADD) {
+            // the reply carries the shard's first bases for the coordinator to share
+            string name, sequence;
+            bool added = channel.getString(name) && channel.getString(sequence) &&
+                         matcher.addGenome(Genome(name, sequence));
+            channel.putInt(added);
+            channel.putString(matcher.firstBases());
+            if (!channel.send()) break;
+        }
+        else if (request == REQUEST_FIRST_BASES) {
+            string bases;
+            if (channel.getString(bases))
+                matcher.addFirstBases(bases);
+            channel.putInt(1);
+            if (!channel.send()) break;
+        }
+        else if (request == REQUEST_FIND) {
+            string fragment;
+            int minimumLength, exactMatchOnly;
+            vector<DNAMatch> matches;
+            if (channel.getString(fragment) && channel.getInt(minimumLength) &&
+                channel.getInt(exactMatchOnly))
+                matcher.findGenomesWithThisDNA(fragment, minimumLength, exactMatchOnly != 0, matches);
+            channel.putInt(static_cast<int>(matches.size()));
+            for (auto it = matches.begin(); it != matches.end(); ++it) {
+                channel.putString(it->genomeName);
+                channel.putInt(it->length);
+                channel.putInt(it->position);
+            }
+            if (!channel.send()) break;
+        }
+        else if (request == REQUEST_RELATED) {
+            string name, sequence;
+            int fragmentMatchLength, exactMatchOnly;
+            double threshold;
+            vector<GenomeMatch> results;
+            if (channel.getString(name) && channel.getString(sequence) &&
+                channel.getInt(fragmentMatchLength) && channel.getInt(exactMatchOnly) &&
+                channel.getDouble(threshold))
+                matcher.findRelatedGenomes(Genome(name, sequence), fragmentMatchLength,
+                                           exactMatchOnly != 0, threshold, results);
+            channel.putInt(static_cast<int>(results.size()));
+            for (auto it = results.begin(); it != results.end(); ++it) {
+                channel.putString(it->genomeName);
+                channel.putDouble(it->percentMatch);
+            }
+            if (!channel.send()) break;
+        }
+    }
+    close(fd);
+}
+
+bool ShardedGenomeMatcherImpl::addGenome(const Genome& genome)
+{
+    // same check as GenomeMatcher, which skips genomes shorter than the minimum search length
+    string sequence;
+    if (m_workers.empty()) return false;
+    if (!genome.extract(0, genome.length(), sequence) || genome.length() < m_minSearchLength)
+        return true;
+    lock_guard<mutex> addGuard(m_addLock);
+    LaneGuard guard(*this);
+    vector<ShardChannel>& channels = m_lanes[guard.lane];
+    ShardChannel& channel = channels[shardOf(genome.name())];
+    channel.putInt(REQUEST_ADD);
+    channel.putString(genome.name());
+    channel.putString(sequence);
+    int added;
+    string bases;
+    if (!channel.send() || !channel.receive() || !channel.getInt(added) || !added ||
+        !channel.getString(bases))
+        return false;
+    if (m_genomeOrder.find(genome.name()) == m_genomeOrder.end())
+        m_genomeOrder[genome.name()] = static_cast<int>(m_genomeOrder.size());
+
+    // a single GenomeMatcher searches a seed if any of its genomes has a k-mer starting with
+    // the seed's first base, so every shard learns the first bases the others have
+    string newBases;
+    for (auto it = bases.begin(); it != bases.end(); ++it)
+        if (m_firstBases.find(*it) == string::npos)
+            newBases += *it;
+    if (newBases.empty()) return true;
+    m_firstBases += newBases;
+    bool ok = true;
+    for (auto it = channels.begin(); it != channels.end(); ++it) {
+        it->putInt(REQUEST_FIRST_BASES);
+        it->putString(newBases);
+        ok = it->send() && ok;
+    }
+    for (auto it = channels.begin(); it != channels.end(); ++it)
+        ok = it->receive() && ok;
+    return ok;
+}
+
+int ShardedGenomeMatcherImpl::minimumSearchLength() const
+{ return m_minSearchLength; }
+
+int ShardedGenomeMatcherImpl::numShards() const
+{ return static_cast<int>(m_workers.size()); }
+
+int ShardedGenomeMatcherImpl::shardOf(const string& name) const
+{
+    // FNV-1a, so the shard of a name doesn't depend on the standard library's hash
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (auto it = name.begin(); it != name.end(); ++it)
+        hash = (hash ^ static_cast<unsigned char>(*it)) * 0x100000001b3ULL;
+    return static_cast<int>(hash % m_workers.size());
+}
+
+int ShardedGenomeMatcherImpl::acquireLane() const
+{
+    unique_lock<mutex> guard(m_laneLock);
+    m_laneFreed.wait(guard, [this] { return !m_freeLanes.empty(); });
+    int lane = m_freeLanes.back();
+    m_freeLanes.pop_back();
+    return lane;
+}
+
+void ShardedGenomeMatcherImpl::releaseLane(int lane) const
+{
+    {
+        lock_guard<mutex> guard(m_laneLock);
+        m_freeLanes.push_back(lane);
+    }
+    m_laneFreed.notify_one();
+}
+
+template<typename Result>
+void ShardedGenomeMatcherImpl::sortByGenomeOrder(vector<Result>& results) const
+{
+    // a single GenomeMatcher reports genomes in the order they were added, and a shard does
+    // the same for its own genomes, so sorting by that order merges the shards' answers
+    stable_sort(results.begin(), results.end(), [this](const Result& a, const Result& b) {
+        return m_genomeOrder.find(a.genomeName)->second < m_genomeOrder.find(b.genomeName)->second;
+    });
+}
+
+bool ShardedGenomeMatcherImpl::findGenomesWithThisDNA(const string& fragment, int minimumLength,
+                                                      bool exactMatchOnly,
+                                                      vector<DNAMatch>& matches) const
+{
+    matches.clear();
+    LaneGuard guard(*this);
+    vector<ShardChannel>& channels = m_lanes[guard.lane];
+
+    // scatter the request to every shard before waiting on any of them, so they all search
+    // at the same time
+    bool ok = !channels.empty();
+    for (auto it = channels.begin(); it != channels.end(); ++it) {
+        it->putInt(REQUEST_FIND);
+        it->putString(fragment);
+        it->putInt(minimumLength);
+        it->putInt(exactMatchOnly);
+        ok = it->send() && ok;
+    }
+    for (auto it = channels.begin(); it != channels.end(); ++it) {
+        int count;
+        if (!it->receive() || !it->getInt(count)) {
+            ok = false;
+            continue;
+        }
+        DNAMatch newMatch;
+        for (int i = 0; i < count; ++i) {
+            if (!it->getString(newMatch.genomeName) || !it->getInt(newMatch.length) ||
+                !it->getInt(newMatch.position))
+                break;
+            matches.push_back(newMatch);
+        }
+    }
+    if (!ok) {
+        matches.clear();
+        return false;
+    }
+    sortByGenomeOrder(matches);
+    return !(matches.empty());
+}
+
+bool ShardedGenomeMatcherImpl::findRelatedGenomes(const Genome& query, int fragmentMatchLength,
+                                                  bool exactMatchOnly, double matchPercentThreshold,
+                                                  vector<GenomeMatch>& results) const
+{
+    results.clear();
+    string sequence;
+    query.extract(0, query.length(), sequence);
+    LaneGuard guard(*this);
+    vector<ShardChannel>& channels = m_lanes[guard.lane];
+
+    bool ok = !channels.empty();
+    for (auto it = channels.begin(); it != channels.end(); ++it) {
+        it->putInt(REQUEST_RELATED);
+        it->putString(query.name());
+        it->putString(sequence);
+        it->putInt(fragmentMatchLength);
+        it->putInt(exactMatchOnly);
+        it->putDouble(matchPercentThreshold);
+        ok = it->send() && ok;
+    }
+    for (auto it = channels.begin(); it != channels.end(); ++it) {
+        int count;
+        if (!it->receive() || !it->getInt(count)) {
+            ok = false;
+            continue;
+        }
+        GenomeMatch newGM;
+        for (int i = 0; i < count; ++i) {
+            if (!it->getString(newGM.genomeName) || !it->getDouble(newGM.percentMatch))
+                break;
+            results.push_back(newGM);
+        }
+    }
+    if (!ok) {
+        results.clear();
+        return false;
+    }
+    sortByGenomeOrder(results);
+    return !(results.empty());
+}
+
+//******************** ShardedGenomeMatcher functions *************************
+
+// These functions simply delegate to ShardedGenomeMatcherImpl's functions.
+
+ShardedGenomeMatcher::ShardedGenomeMatcher(int minSearchLength, int numShards, IndexKind index, const IndexOptions& options)
+{
+    m_impl = new ShardedGenomeMatcherImpl(minSearchLength, numShards, index, options);
+}
+
+ShardedGenomeMatcher::~ShardedGenomeMatcher()
+{
+    delete m_impl;
+}
+
+bool ShardedGenomeMatcher::addGenome(const Genome& genome)
+{
+    return m_impl->addGenome(genome);
+}
+
+int ShardedGenomeMatcher::minimumSearchLength() const
+{
+    return m_impl->minimumSearchLength();
+}
+
+int ShardedGenomeMatcher::numShards() const
+{
+    return m_impl->numShards();
+}
+
+bool ShardedGenomeMatcher::findGenomesWithThisDNA(const string& fragment, int minimumLength, bool exactMatchOnly, vector<DNAMatch>& matches) const
+{
+    return m_impl->findGenomesWithThisDNA(fragment, minimumLength, exactMatchOnly, matches);
+}
+
+bool ShardedGenomeMatcher::findRelatedGenomes(const Genome& query, int fragmentMatchLength, bool exactMatchOnly, double matchPercentThreshold, vector<GenomeMatch>& results) const
+{
+    return m_impl->findRelatedGenomes(query, fragmentMatchLength, exactMatchOnly, matchPercentThreshold, results);
+}
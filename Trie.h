@@ -14,9 +14,9 @@ class Trie
 public:
     // Constructor
     //
-    // Pre-condition: Only default constructor can be called
+    // Pre-condition: maximum number of values a key may hold (0 for no limit)
     // Post-condition: Create a new trieNode and assign address to root
-    Trie();
+    Trie(size_t maxValuesPerKey = 0);
     
     // Destructor
     //
@@ -34,22 +34,40 @@ public:
     //
     // Pre-condition: a string and a value to be stored in trie
     // Post-condition: branch the trie with characters in string and store the value
-    //                 at the end of the node. (use helper function)
+    //                 at the end of the node. (use helper function) once a key has more
+    //                 values than the limit, its values are dropped and it takes no more
     void insert(const std::string& key, const ValueType& value);
+    //
+    // Pre-condition: a string to stop-list
+    // Post-condition: branch the trie with characters in string and mark the end node as over
+    //                 the limit, dropping its values
+    void stopList(const std::string& key);
     
     // Accessor Functions
     //
     // Pre-condition: a string to search in trie and boolean for exact match condition
     // Post-condition: returns the value stored at the end of the node if the string is
-    //                 branched in the trie. (use helper function)
+    //                 branched in the trie. (use visit)
     std::vector<ValueType> find(const std::string& key, bool exactMatchOnly) const;
+    //
+    // Pre-condition: same as above, a function taking each value found and returning false
+    //                to stop, and a boolean to store whether a key over the limit was reached
+    // Post-condition: call the function with the values find would return, in the same order,
+    //                 without collecting them, and returns how many it was called with. unlike
+    //                 find, a first character that isn't a root label doesn't end the search,
+    //                 so the caller decides that rule
+    template<typename Visitor>
+    size_t visit(const std::string& key, bool exactMatchOnly, Visitor visitor, bool& limited) const;
 
       // C++11 syntax for preventing copying and assignment
     Trie(const Trie&) = delete;
     Trie& operator=(const Trie&) = delete;
 private:
+    size_t maxValues;
     struct trieNode {
+        trieNode() : overLimit(false) { }
         std::vector<ValueType> values;
+        bool overLimit;
         struct triePointer {
             std::vector<char> label;
             std::vector<trieNode*> trieNodePtr;
@@ -67,18 +85,21 @@ private:
     //                 insert the value at the node once key becomes empty
     void insertChildren(const std::string& key, const ValueType& value, trieNode* current);
     //
-    // Pre-condition: key string to search, condition for exact match, pointer to trieNode,
-    //                and vector to store values
-    // Post-condition: recursively traverse trie with each character in the key and insert
-    //                 all values found in the end node to the vector
-    void searchChildren(const std::string& key, bool exactMatchOnly, trieNode* current,
-                        std::vector<ValueType> &matchedValues) const;
+    // Pre-condition: key string to search, index of the next character, condition for exact
+    //                match, pointer to trieNode, function to call, count of values visited,
+    //                and boolean to mark keys over the limit
+    // Post-condition: recursively traverse trie with each character in the key and call the
+    //                 function with all values found in the end node. returns false once the
+    //                 function has returned false
+    template<typename Visitor>
+    bool visitChildren(const std::string& key, size_t next, bool exactMatchOnly,
+                       trieNode* current, Visitor& visitor, size_t& visited, bool& limited) const;
 };
 
 
 template<typename ValueType>
-Trie<ValueType>::Trie()
-     : root(new trieNode) { }
+Trie<ValueType>::Trie(size_t maxValuesPerKey)
+     : maxValues(maxValuesPerKey), root(new trieNode) { }
 
 
 template<typename ValueType>
@@ -122,11 +143,19 @@ void Trie<ValueType>::insertChildren(const std::string& key,
                                      const ValueType& value,
                                      trieNode* current)
 {
-    // base case: if key is empty, insert the value at the current node
-    if (key == "") current->values.push_back(value);
+    // base case: if key is empty, insert the value at the current node unless the node
+    // went over the limit. the node that goes over it releases all of its values
+    if (key == "") {
+        if (current->overLimit) return;
+        current->values.push_back(value);
+        if (maxValues > 0 && current->values.size() > maxValues) {
+            current->overLimit = true;
+            std::vector<ValueType>().swap(current->values);
+        }
+    }
     else {
         // find the index of child that has matching label as first character in key
-        int i = 0;
+        size_t i = 0;
         while (i < current->children.label.size()) {
             if (current->children.label[i] == key[0]) break;
             ++i;
@@ -148,6 +177,25 @@ void Trie<ValueType>::insertChildren(const std::string& key,
 }
 
 
+template<typename ValueType>
+void Trie<ValueType>::stopList(const std::string& key)
+{
+    // walk down the key, creating nodes where needed, same as insertChildren
+    trieNode* current = root;
+    for (size_t k = 0; k < key.size(); ++k) {
+        size_t i = 0;
+        while (i < current->children.label.size() && current->children.label[i] != key[k]) ++i;
+        if (i == current->children.label.size()) {
+            current->children.label.push_back(key[k]);
+            current->children.trieNodePtr.push_back(new trieNode);
+        }
+        current = current->children.trieNodePtr[i];
+    }
+    current->overLimit = true;
+    std::vector<ValueType>().swap(current->values);
+}
+
+
 template<typename ValueType>
 std::vector<ValueType> Trie<ValueType>::find(const std::string& key,
                                              bool exactMatchOnly) const
@@ -156,11 +204,15 @@ std::vector<ValueType> Trie<ValueType>::find(const std::string& key,
     std::vector<ValueType> newVector;
     
     // check if the first character of the key is within the root's children label
-    // if the child with matching label exists, use searchChildren function
+    // if the child with matching label exists, collect the values visit finds
     auto it = root->children.label.begin();
     for (; it != root->children.label.end(); ++it) {
         if (*it == key[0]) {
-            searchChildren(key, exactMatchOnly, root, newVector);
+            bool limited;
+            visit(key, exactMatchOnly, [&newVector](const ValueType& value) {
+                newVector.push_back(value);
+                return true;
+            }, limited);
             break;
         }
     }
@@ -170,39 +222,54 @@ std::vector<ValueType> Trie<ValueType>::find(const std::string& key,
 
 
 template<typename ValueType>
-void Trie<ValueType>::searchChildren(const std::string& key,
-                                     bool exactMatchOnly,
-                                     trieNode* current,
-                                     std::vector<ValueType> &matchedValues) const
+template<typename Visitor>
+size_t Trie<ValueType>::visit(const std::string& key,
+                              bool exactMatchOnly,
+                              Visitor visitor,
+                              bool& limited) const
 {
-    // base case: if key is empty, insert all values stored at current node to the vector
-    if (key == "")
-        for (auto it = current->values.begin(); it != current->values.end(); ++it)
-            matchedValues.push_back(*it);
-    else {
-        // iterate through each child to check if label matches with first character in key
-        // case 1 (matched):
-        // recursive call with key excluding first character and child pointer
-        // case 2 (unmatched and exactMatchOnly is false):
-        // recursive call with key excluding first character, true for exact match condition,
-        // and child pointer
-        // case 3 (unmatched and exactMatchOnly is true):
-        // do nothing
-        for (int index = 0; index < current->children.label.size(); ++index) {
-            if (key[0] == current->children.label[index]) {
-                searchChildren(key.substr(1),
-                               exactMatchOnly,
-                               current->children.trieNodePtr[index],
-                               matchedValues);
-            }
-            else if (!exactMatchOnly) {
-                searchChildren(key.substr(1),
-                               true,
-                               current->children.trieNodePtr[index],
-                               matchedValues);
-            }
+    size_t visited = 0;
+    limited = false;
+    visitChildren(key, 0, exactMatchOnly, root, visitor, visited, limited);
+    return visited;
+}
+
+
+template<typename ValueType>
+template<typename Visitor>
+bool Trie<ValueType>::visitChildren(const std::string& key,
+                                    size_t next,
+                                    bool exactMatchOnly,
+                                    trieNode* current,
+                                    Visitor& visitor,
+                                    size_t& visited,
+                                    bool& limited) const
+{
+    // base case: at the end of the key, visit all values stored at current node
+    if (next == key.size()) {
+        if (current->overLimit) limited = true;
+        for (auto it = current->values.begin(); it != current->values.end(); ++it) {
+            visited++;
+            if (!visitor(*it)) return false;
         }
+        return true;
+    }
+    
+    // iterate through each child to check if label matches with the next character in key
+    // case 1 (matched):
+    // recursive call with the next character and child pointer
+    // case 2 (unmatched and exactMatchOnly is false):
+    // recursive call with the next character, true for exact match condition, and child pointer
+    // case 3 (unmatched and exactMatchOnly is true):
+    // do nothing
+    for (size_t index = 0; index < current->children.label.size(); ++index) {
+        const bool matched = key[next] == current->children.label[index];
+        if (!matched && exactMatchOnly) continue;
+        if (!visitChildren(key, next + 1, exactMatchOnly || !matched,
+                           current->children.trieNodePtr[index], visitor, visited, limited))
+            return false;
     }
+    return true;
 }
 
 #endif // TRIE_INCLUDED
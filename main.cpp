@@ -1,4 +1,6 @@
 #include "provided.h"
+#include "BoundedQueue.h"
+#include "ReorderWindow.h"
 #include <iostream>
 #include <iomanip>
 #include <fstream>
@@ -6,6 +8,14 @@
 #include <vector>
 #include <cctype>
 #include <cstdlib>
+#include <chrono>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <atomic>
+#include <map>
+#include <cstdio>
+#include <unistd.h>
 using namespace std;
 
 // Change the string literal in this declaration to be the path to the
@@ -36,8 +46,75 @@ void createNewLibrary(GenomeMatcher*& library)
         cout << "Invalid prefix size." << endl;
         return;
     }
+    cout << "Index with (t)rie or (k)-mer hash table (t or k): ";
+    getline(cin, line);
+    if (line.empty() || (line[0] != 't' && line[0] != 'k'))
+    {
+        cout << "Response must be t or k." << endl;
+        return;
+    }
+    IndexKind index = (line[0] == 'k') ? IndexKind::KmerHash : IndexKind::Trie;
+    if (index == IndexKind::KmerHash && len > 32)
+        cout << "k-mer hash table needs a minimum search length of at most 32; using trie." << endl;
+    IndexOptions options;
+    cout << "Enter k-mer frequency cap (0 for none): ";
+    getline(cin, line);
+    options.maxKmerFrequency = atoi(line.c_str());
+    if (options.maxKmerFrequency < 0)
+    {
+        cout << "Frequency cap must not be negative." << endl;
+        return;
+    }
+    cout << "Leave out k-mers with N and low complexity regions (y or n): ";
+    getline(cin, line);
+    if (line.empty() || (line[0] != 'y' && line[0] != 'n'))
+    {
+        cout << "Response must be y or n." << endl;
+        return;
+    }
+    options.skipAmbiguousKmers = options.maskLowComplexity = (line[0] == 'y');
+    cout << "Enter directory for memory-mapped storage (empty to keep the library in memory): ";
+    getline(cin, options.storageDirectory);
+    if (!options.storageDirectory.empty() && index == IndexKind::KmerHash)
+    {
+        cout << "Enter memory for the postings of the most frequent k-mers in megabytes: ";
+        getline(cin, line);
+        options.hotPostingBytes = atoll(line.c_str()) * 1024 * 1024;
+        if (options.hotPostingBytes < 0)
+        {
+            cout << "Memory must not be negative." << endl;
+            return;
+        }
+    }
+    cout << "Enter number of exact/SNiP search results to cache (0 for none): ";
+    getline(cin, line);
+    options.resultCacheEntries = atoi(line.c_str());
+    if (options.resultCacheEntries < 0)
+    {
+        cout << "Cache size must not be negative." << endl;
+        return;
+    }
+    if (options.resultCacheEntries > 0)
+    {
+        cout << "Enter memory limit of the cache in megabytes (0 for none): ";
+        getline(cin, line);
+        options.resultCacheBytes = atoll(line.c_str()) * 1024 * 1024;
+        if (options.resultCacheBytes < 0)
+        {
+            cout << "Memory limit must not be negative." << endl;
+            return;
+        }
+    }
+    cout << "Enter false positive rate of per-genome k-mer filters (0 for no filters): ";
+    getline(cin, line);
+    options.filterFalsePositiveRate = atof(line.c_str());
+    if (options.filterFalsePositiveRate < 0 || options.filterFalsePositiveRate >= 1)
+    {
+        cout << "False positive rate must be at least 0 and less than 1." << endl;
+        return;
+    }
     delete library;
-    library = new GenomeMatcher(len);
+    library = new GenomeMatcher(len, index, options);
 }
 
 void addOneGenomeManually(GenomeMatcher* library)
@@ -65,7 +142,8 @@ void addOneGenomeManually(GenomeMatcher* library)
     }
     for (char ch : sequence)
         ch = toupper(ch);
-    library->addGenome(Genome(name, sequence));
+    if (!library->addGenome(Genome(name, sequence)))
+        cout << "Could not store the genome." << endl;
 }
 
 bool loadFile(string filename, vector<Genome>& genomes)
@@ -98,7 +176,13 @@ void loadOneDataFile(GenomeMatcher* library)
     if (!loadFile(filename, genomes))
         return;
     for (const auto& g : genomes)
-        library->addGenome(g);
+    {
+        if (!library->addGenome(g))
+        {
+            cout << "Could not store genome " << g.name() << "." << endl;
+            return;
+        }
+    }
     cout << "Successfully loaded " << genomes.size() << " genomes." << endl;
 }
 
@@ -110,7 +194,13 @@ void loadProvidedFiles(GenomeMatcher* library)
         if (loadFile(PROVIDED_DIR + "/" + f, genomes))
         {
             for (const auto& g : genomes)
-                library->addGenome(g);
+            {
+                if (!library->addGenome(g))
+                {
+                    cout << "Could not store genome " << g.name() << "." << endl;
+                    return;
+                }
+            }
             cout << "Loaded " << genomes.size() << " genomes from " << f << endl;
         }
     }
@@ -125,7 +215,7 @@ void findGenome(GenomeMatcher* library, bool exactMatch)
     string sequence;
     getline(cin, sequence);
     int minLength = library->minimumSearchLength();
-    if (sequence.size() < minLength)
+    if (static_cast<int>(sequence.size()) < minLength)
     {
         cout << "DNA sequence length must be at least " << minLength << endl;
         return;
@@ -134,13 +224,20 @@ void findGenome(GenomeMatcher* library, bool exactMatch)
     string line;
     getline(cin, line);
     int minMatchLength = atoi(line.c_str());
-    if (minMatchLength > sequence.size())
+    if (minMatchLength > static_cast<int>(sequence.size()))
     {
         cout << "Minimum match length must be at least the sequence length." << endl;
         return;
     }
     vector<DNAMatch> matches;
-    if (!library->findGenomesWithThisDNA(sequence, minMatchLength, exactMatch, matches))
+    library->resetQueryStats();
+    bool found = library->findGenomesWithThisDNA(sequence, minMatchLength, exactMatch, matches);
+    QueryStats stats = library->queryStats();
+    if (stats.seedsCapped > 0)
+        cout << "(" << stats.seedsCapped << " capped seeds, " << stats.fallbackSeeds << " fallback seeds)" << endl;
+    if (stats.cacheHits > 0)
+        cout << "(answered from the result cache)" << endl;
+    if (!found)
     {
         cout << "No ";
         if (exactMatch)
@@ -160,6 +257,93 @@ void findGenome(GenomeMatcher* library, bool exactMatch)
         cout << "  length " << m.length << " position " << m.position << " in " << m.genomeName << endl;
 }
 
+void listAllMatches(GenomeMatcher* library)
+{
+    cout << "Enter DNA sequence for which to list every match: ";
+    string sequence;
+    getline(cin, sequence);
+    int minLength = library->minimumSearchLength();
+    if (static_cast<int>(sequence.size()) < minLength)
+    {
+        cout << "DNA sequence length must be at least " << minLength << endl;
+        return;
+    }
+    cout << "Enter minimum sequence match length: ";
+    string line;
+    getline(cin, line);
+    int minMatchLength = atoi(line.c_str());
+    if (minMatchLength > static_cast<int>(sequence.size()))
+    {
+        cout << "Minimum match length must be at least the sequence length." << endl;
+        return;
+    }
+    cout << "Require (e)xact match or allow (S)NiPs (e or s): ";
+    getline(cin, line);
+    if (line.empty() || (line[0] != 'e' && line[0] != 's'))
+    {
+        cout << "Response must be e or s." << endl;
+        return;
+    }
+    bool exactMatch = (line[0] == 'e');
+    cout << "Enter maximum matches per genome (0 for no limit): ";
+    getline(cin, line);
+    int maxPerGenome = atoi(line.c_str());
+    int count = library->enumerateDNAMatches(sequence, minMatchLength, exactMatch,
+        [](const DNAMatch& m) {
+            cout << "  length " << m.length << " position " << m.position << " in " << m.genomeName << '\n';
+            return true;
+        }, maxPerGenome);
+    cout << count << " matches of " << sequence << " found." << endl;
+}
+
+void findSimilarGenome(GenomeMatcher* library)
+{
+    cout << "Enter DNA sequence for which to find matches with edits: ";
+    string sequence;
+    getline(cin, sequence);
+    int minLength = library->minimumSearchLength();
+    if (static_cast<int>(sequence.size()) < minLength)
+    {
+        cout << "DNA sequence length must be at least " << minLength << endl;
+        return;
+    }
+    cout << "Enter minimum sequence match length: ";
+    string line;
+    getline(cin, line);
+    int minMatchLength = atoi(line.c_str());
+    if (minMatchLength > static_cast<int>(sequence.size()))
+    {
+        cout << "Minimum match length must be at least the sequence length." << endl;
+        return;
+    }
+    cout << "Enter maximum number of edits: ";
+    getline(cin, line);
+    int maxEdits = atoi(line.c_str());
+    if (maxEdits < 0)
+    {
+        cout << "Number of edits must not be negative." << endl;
+        return;
+    }
+    cout << "Allow (s)ubstitutions only or also (i)ndels (s or i): ";
+    getline(cin, line);
+    if (line.empty() || (line[0] != 's' && line[0] != 'i'))
+    {
+        cout << "Response must be s or i." << endl;
+        return;
+    }
+    bool allowIndels = (line[0] == 'i');
+    vector<DNAMatch> matches;
+    if (!library->findGenomesWithSimilarDNA(sequence, minMatchLength, maxEdits, allowIndels, matches))
+    {
+        cout << "No matches with up to " << maxEdits << " edits of " << sequence << " were found"
+             << " (or the minimum match length is too short to search for that many edits)." << endl;
+        return;
+    }
+    cout << matches.size() << " matches with up to " << maxEdits << " edits of " << sequence << " found:" << endl;
+    for (const auto& m : matches)
+        cout << "  length " << m.length << " position " << m.position << " in " << m.genomeName << endl;
+}
+
 bool getFindRelatedParams(double& pct, bool& exactMatchOnly)
 {
     cout << "Enter match percentage threshold (0-100): ";
@@ -188,7 +372,7 @@ void findRelatedGenomesManual(GenomeMatcher* library)
     string sequence;
     getline(cin, sequence);
     int minLength = library->minimumSearchLength();
-    if (sequence.size() < minLength)
+    if (static_cast<int>(sequence.size()) < minLength)
     {
         cout << "DNA sequence length must be at least " << minLength << endl;
         return;
@@ -212,6 +396,49 @@ void findRelatedGenomesManual(GenomeMatcher* library)
         cout << " " << setw(6) << m.percentMatch << "%  " << m.genomeName << endl;
 }
 
+void findRelatedGenomesByKmers(GenomeMatcher* library)
+{
+    cout << "Enter DNA sequence: ";
+    string sequence;
+    getline(cin, sequence);
+    int minLength = library->minimumSearchLength();
+    if (static_cast<int>(sequence.size()) < minLength)
+    {
+        cout << "DNA sequence length must be at least " << minLength << endl;
+        return;
+    }
+    cout << "Enter window length (" << minLength << "-32): ";
+    string line;
+    getline(cin, line);
+    int windowLength = atoi(line.c_str());
+    if (windowLength < minLength || windowLength > 32)
+    {
+        cout << "Window length must be in the range " << minLength << " to 32." << endl;
+        return;
+    }
+    cout << "Enter containment percentage threshold (0-100): ";
+    getline(cin, line);
+    double pctThreshold = atof(line.c_str());
+    if (pctThreshold < 0  ||  pctThreshold > 100)
+    {
+        cout << "Percentage must be in the range 0 to 100." << endl;
+        return;
+    }
+    
+    vector<GenomeSimilarity> matches;
+    library->findRelatedGenomesByKmers(Genome("x", sequence), windowLength, pctThreshold, matches);
+    if (matches.empty())
+    {
+        cout << "    No related genomes were found" << endl;
+        return;
+    }
+    cout << "    " << matches.size() << " related genomes were found:" << endl;
+    cout.setf(ios::fixed);
+    cout.precision(2);
+    for (const auto& m : matches)
+        cout << " " << setw(6) << m.containment << "% contained " << setw(6) << m.jaccard << "% jaccard  " << m.genomeName << endl;
+}
+
 void findRelatedGenomesFromFile(GenomeMatcher* library)
 {
     string filename;
@@ -222,31 +449,423 @@ void findRelatedGenomesFromFile(GenomeMatcher* library)
         cout << "No file name entered." << endl;
         return;
     }
-    vector<Genome> genomes;
-    if (!loadFile(filename, genomes))
+    ifstream inputf(filename);
+    if (!inputf)
+    {
+        cout << "Cannot open file: " << filename << endl;
         return;
+    }
     double pctThreshold;
     bool exactMatchOnly;
     if (!getFindRelatedParams(pctThreshold, exactMatchOnly))
         return;
     
-    int minLength = library->minimumSearchLength();
-    for (const auto& g : genomes)
+    // a reader thread parses genomes one at a time, workers search and format one genome
+    // each, and this thread prints the reports in file order. the window keeps the reader at
+    // most a few genomes ahead of the printed ones, so only those are in memory however large
+    // the file is and however long one genome takes
+    struct Query
+    {
+        int number;
+        Genome genome;
+    };
+    struct Report
+    {
+        int number;
+        string text;
+    };
+    const int numWorkers = max(1, static_cast<int>(thread::hardware_concurrency()));
+    BoundedQueue<Query> queries(2 * numWorkers);
+    BoundedQueue<Report> reports(2 * numWorkers);
+    ReorderWindow window(4 * numWorkers);
+    bool formatted = true;
+    
+    thread reader([&]()
+    {
+        GenomeReader genomes(inputf);
+        string name, sequence;
+        for (int number = 0; ; ++number)
+        {
+            window.waitToStart(number);
+            if (!genomes.next(name, sequence) || !queries.push(Query{ number, Genome(name, sequence) }))
+                break;
+        }
+        formatted = !genomes.bad();
+        queries.close();
+    });
+    
+    const int minLength = library->minimumSearchLength();
+    atomic<int> running(numWorkers);
+    auto worker = [&]()
     {
+        Query query{ 0, Genome("", "") };
         vector<GenomeMatch> matches;
-        library->findRelatedGenomes(g, 2 * minLength, exactMatchOnly, pctThreshold, matches);
-        cout << "  For " << g.name() << endl;
-        if (matches.empty())
+        while (queries.pop(query))
         {
-            cout << "    No related genomes were found" << endl;
+            library->findRelatedGenomes(query.genome, 2 * minLength, exactMatchOnly, pctThreshold, matches);
+            ostringstream text;
+            text << "  For " << query.genome.name() << '\n';
+            if (matches.empty())
+                text << "    No related genomes were found\n";
+            else
+            {
+                text << "    " << matches.size() << " related genomes were found:\n";
+                text.setf(ios::fixed);
+                text.precision(2);
+                for (const auto& m : matches)
+                    text << "     " << setw(6) << m.percentMatch << "%  " << m.genomeName << '\n';
+            }
+            reports.push(Report{ query.number, text.str() });
+        }
+        if (--running == 0)
+            reports.close();
+    };
+    vector<thread> workers;
+    for (int t = 0; t < numWorkers; ++t)
+        workers.push_back(thread(worker));
+    
+    // reports finish out of order, so early ones wait until it is their turn
+    map<int, string> waiting;
+    int next = 0;
+    Report report;
+    while (reports.pop(report))
+    {
+        waiting[report.number].swap(report.text);
+        for (auto it = waiting.find(next); it != waiting.end(); it = waiting.find(++next))
+        {
+            cout << it->second;
+            waiting.erase(it);
+            window.handled();
+        }
+    }
+    reader.join();
+    for (auto& t : workers)
+        t.join();
+    cout.flush();
+    if (!formatted)
+        cout << "Improperly formatted file: " << filename << endl;
+}
+
+void writeSimilarityMatrix(GenomeMatcher* library)
+{
+    string filename;
+    cout << "Enter name of file to write the similarity matrix to: ";
+    getline(cin, filename);
+    if (filename.empty())
+    {
+        cout << "No file name entered." << endl;
+        return;
+    }
+    cout << "Write (d)ense or (s)parse matrix (d or s): ";
+    string line;
+    getline(cin, line);
+    if (line.empty() || (line[0] != 'd' && line[0] != 's'))
+    {
+        cout << "Response must be d or s." << endl;
+        return;
+    }
+    bool sparse = (line[0] == 's');
+    cout << "Require (e)xact match or allow (S)NiPs (e or s): ";
+    getline(cin, line);
+    if (line.empty() || (line[0] != 'e' && line[0] != 's'))
+    {
+        cout << "Response must be e or s." << endl;
+        return;
+    }
+    bool exactMatchOnly = (line[0] == 'e');
+    
+    int minLength = library->minimumSearchLength();
+    int lastPercent = -1;
+    bool written = library->computeSimilarityMatrix(2 * minLength, exactMatchOnly, filename, sparse,
+        [&lastPercent](int completed, int total) {
+            int percent = completed * 100 / total;
+            if (percent / 10 != lastPercent / 10)
+                cout << "    " << percent << "% done" << endl;
+            lastPercent = percent;
+        });
+    if (!written)
+    {
+        cout << "Cannot write file: " << filename << endl;
+        return;
+    }
+    cout << "Similarity matrix written to " << filename << endl;
+}
+
+double secondsSince(chrono::steady_clock::time_point start)
+{
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+void classifyReadsFromFile(GenomeMatcher* library)
+{
+    string readsFile, outputFile;
+    cout << "Enter name of FASTQ file of reads (plain or gzip): ";
+    getline(cin, readsFile);
+    if (readsFile.empty())
+    {
+        cout << "No file name entered." << endl;
+        return;
+    }
+    cout << "Enter name of file to write the assignments to: ";
+    getline(cin, outputFile);
+    if (outputFile.empty())
+    {
+        cout << "No file name entered." << endl;
+        return;
+    }
+    long long reads;
+    auto start = chrono::steady_clock::now();
+    bool classified = library->classifyReads(readsFile, outputFile, reads);
+    double seconds = secondsSince(start);
+    if (!classified)
+    {
+        cout << "Cannot classify reads of " << readsFile << " into " << outputFile
+             << " (" << reads << " reads written)" << endl;
+        return;
+    }
+    cout.setf(ios::fixed);
+    cout << reads << " reads classified in " << setprecision(2) << seconds << "s ("
+         << setprecision(0) << (seconds > 0 ? reads / seconds * 60 : 0) << " reads per minute)" << endl;
+}
+
+void benchmarkReadClassification()
+{
+    cout << "Enter data file to benchmark on: ";
+    string filename;
+    getline(cin, filename);
+    vector<Genome> loaded;
+    if (filename.empty() || !loadFile(filename, loaded))
+        return;
+    
+    // reads come from genomes long enough to hold one, and with a single name every read
+    // would be assigned correctly whatever the index did
+    const int readLength = 150;
+    vector<Genome> genomes;
+    map<string, int> names;
+    for (const auto& g : loaded)
+        if (g.length() >= readLength)
+        {
+            genomes.push_back(g);
+            names[g.name()]++;
+        }
+    if (names.size() < 2)
+    {
+        cout << "Need genomes of at least " << readLength << " bases under two or more names in "
+             << filename << endl;
+        return;
+    }
+    cout << "Enter number of reads to simulate (e.g. 1000000): ";
+    string line;
+    getline(cin, line);
+    int numReads = atoi(line.c_str());
+    if (numReads <= 0)
+    {
+        cout << "Number of reads must be positive." << endl;
+        return;
+    }
+    
+    // 150 base reads from random genomes with 1% substitutions, written to a FASTQ file so
+    // that parsing is timed too. the files go into a fresh temporary directory
+    char directory[] = "/tmp/geenomics-XXXXXX";
+    if (mkdtemp(directory) == nullptr)
+    {
+        cout << "Cannot create a temporary directory for the reads." << endl;
+        return;
+    }
+    const char bases[] = "ACGT";
+    const string readsFile = string(directory) + "/reads.fq";
+    const string outputFile = string(directory) + "/assignments.tsv";
+    auto removeFiles = [&]()
+    {
+        remove(readsFile.c_str());
+        remove(outputFile.c_str());
+        rmdir(directory);
+    };
+    mt19937 rng(numReads);
+    vector<string> truth;
+    ofstream reads(readsFile);
+    const string quality(readLength, 'I');
+    while (static_cast<int>(truth.size()) < numReads)
+    {
+        const Genome& g = genomes[rng() % genomes.size()];
+        string read;
+        if (!g.extract(rng() % (g.length() - readLength + 1), readLength, read))
             continue;
+        for (int e = 0; e < readLength / 100; ++e)
+            read[rng() % readLength] = bases[rng() % 4];
+        reads << '@' << truth.size() << '\n' << read << "\n+\n" << quality << '\n';
+        truth.push_back(g.name());
+    }
+    reads.close();
+    
+    GenomeMatcher matcher(20, IndexKind::KmerHash);
+    auto start = chrono::steady_clock::now();
+    for (const auto& g : genomes)
+        matcher.addGenome(g);
+    ReadAssignment assignment;
+    matcher.classifyRead("", assignment);
+    double build = secondsSince(start);
+    long long classified;
+    start = chrono::steady_clock::now();
+    if (!matcher.classifyReads(readsFile, outputFile, classified))
+    {
+        cout << "Cannot classify reads." << endl;
+        removeFiles();
+        return;
+    }
+    double seconds = secondsSince(start);
+    
+    // the read's genome or one with the same name counts as correct. a read is ambiguous
+    // when another genome has as many hits, and then counts as correct only by luck
+    ifstream assignments(outputFile);
+    int correct = 0, ambiguous = 0;
+    for (int r = 0; r < numReads && getline(assignments, line); ++r)
+    {
+        size_t name = line.find('\t') + 1;
+        if (line.compare(name, line.find('\t', name) - name, truth[r]) == 0)
+            correct++;
+        if (line.size() >= 2 && line.compare(line.size() - 2, 2, "\t1") == 0)
+            ambiguous++;
+    }
+    assignments.close();
+    removeFiles();
+    cout.setf(ios::fixed);
+    cout << genomes.size() << " genomes under " << names.size() << " names, index built in "
+         << setprecision(2) << build << "s, " << classified << " reads in " << seconds << "s: "
+         << setprecision(0) << (seconds > 0 ? classified / seconds * 60 : 0) << " reads per minute, "
+         << setprecision(2) << 100.0 * correct / numReads << "% assigned to their genome, "
+         << 100.0 * ambiguous / numReads << "% ambiguous" << endl;
+}
+
+void benchmarkIndexes()
+{
+    cout << "Enter data file to benchmark on: ";
+    string filename;
+    getline(cin, filename);
+    vector<Genome> genomes;
+    if (filename.empty() || !loadFile(filename, genomes))
+        return;
+    cout << "Enter number of bases per genome to index (e.g. 100000): ";
+    string line;
+    getline(cin, line);
+    int maxBases = atoi(line.c_str());
+    if (maxBases <= 0)
+    {
+        cout << "Number of bases must be positive." << endl;
+        return;
+    }
+    vector<Genome> library;
+    for (const auto& g : genomes)
+    {
+        string sequence;
+        int length = min(g.length(), maxBases);
+        if (length > 0 && g.extract(0, length, sequence))
+            library.push_back(Genome(g.name(), sequence));
+    }
+    if (library.empty())
+    {
+        cout << "No genomes to benchmark on in " << filename << endl;
+        return;
+    }
+    
+    // every query is a 2k fragment of an indexed genome with one base changed half the time,
+    // so exact and SNiP searches both have hits to extend
+    const int numQueries = 2000;
+    const int kValues[] = { 10, 12, 16, 20, 24, 28, 32 };
+    const char bases[] = "ACGT";
+    cout << "    k  index     build(s)  exact(q/s)  SNiP(q/s)" << endl;
+    cout.setf(ios::fixed);
+    for (int k : kValues)
+    {
+        mt19937 rng(k);
+        vector<string> queries;
+        for (int q = 0; q < numQueries; ++q)
+        {
+            const Genome& g = library[rng() % library.size()];
+            string fragment;
+            if (g.length() < 2 * k || !g.extract(rng() % (g.length() - 2 * k + 1), 2 * k, fragment))
+                continue;
+            if (rng() % 2)
+                fragment[rng() % fragment.size()] = bases[rng() % 4];
+            queries.push_back(fragment);
         }
-        cout << "    " << matches.size() << " related genomes were found:" << endl;
-        cout.setf(ios::fixed);
-        cout.precision(2);
-        for (const auto& m : matches)
-            cout << "     " << setw(6) << m.percentMatch << "%  " << m.genomeName << endl;
+        
+        for (IndexKind index : { IndexKind::Trie, IndexKind::KmerHash })
+        {
+            GenomeMatcher matcher(k, index);
+            auto start = chrono::steady_clock::now();
+            for (const auto& g : library)
+                matcher.addGenome(g);
+            vector<DNAMatch> matches;
+            matcher.findGenomesWithThisDNA(queries.empty() ? "" : queries[0], k, true, matches);
+            double build = secondsSince(start);
+            
+            double rate[2];
+            for (int exact = 1; exact >= 0; --exact)
+            {
+                start = chrono::steady_clock::now();
+                for (const auto& q : queries)
+                    matcher.findGenomesWithThisDNA(q, k, exact == 1, matches);
+                rate[1 - exact] = queries.size() / secondsSince(start);
+            }
+            cout << "   " << setw(2) << k << "  " << (index == IndexKind::Trie ? "trie    " : "k-mer   ")
+                 << setprecision(3) << setw(9) << build << "  "
+                 << setprecision(0) << setw(10) << rate[0] << "  " << setw(9) << rate[1] << endl;
+        }
+    }
+}
+
+void benchmarkShards()
+{
+    cout << "Enter data file to benchmark on: ";
+    string filename;
+    getline(cin, filename);
+    vector<Genome> genomes;
+    if (filename.empty() || !loadFile(filename, genomes))
+        return;
+    cout << "Enter number of shards: ";
+    string line;
+    getline(cin, line);
+    int numShards = atoi(line.c_str());
+    if (numShards <= 0)
+    {
+        cout << "Number of shards must be positive." << endl;
+        return;
+    }
+    
+    // the sharded library must answer exactly like the single one, so every answer is
+    // compared while both are timed
+    const int k = 16;
+    GenomeMatcher single(k, IndexKind::KmerHash);
+    ShardedGenomeMatcher sharded(k, numShards, IndexKind::KmerHash);
+    for (const auto& g : genomes)
+    {
+        single.addGenome(g);
+        sharded.addGenome(g);
     }
+    mt19937 rng(numShards);
+    int differences = 0;
+    double singleTime = 0, shardedTime = 0;
+    for (const auto& g : genomes)
+    {
+        vector<GenomeMatch> singleResults, shardedResults;
+        const bool exactMatchOnly = rng() % 2 == 0;
+        auto start = chrono::steady_clock::now();
+        single.findRelatedGenomes(g, 2 * k, exactMatchOnly, 1, singleResults);
+        singleTime += secondsSince(start);
+        start = chrono::steady_clock::now();
+        sharded.findRelatedGenomes(g, 2 * k, exactMatchOnly, 1, shardedResults);
+        shardedTime += secondsSince(start);
+        bool same = singleResults.size() == shardedResults.size();
+        for (size_t i = 0; same && i < singleResults.size(); ++i)
+            same = singleResults[i].genomeName == shardedResults[i].genomeName &&
+                   singleResults[i].percentMatch == shardedResults[i].percentMatch;
+        if (!same) differences++;
+    }
+    cout.setf(ios::fixed);
+    cout << genomes.size() << " related genome searches: single " << setprecision(3) << singleTime
+         << "s, " << sharded.numShards() << " shards " << shardedTime << "s, "
+         << differences << " different answers" << endl;
 }
 
 void showMenu()
@@ -257,6 +876,11 @@ void showMenu()
     cout << "         l - load one data file             f - find related genomes (file)" << endl;
     cout << "         d - load all provided data files   ? - show this menu" << endl;
     cout << "         e - find matches exactly           q - quit" << endl;
+    cout << "         i - find matches with edits        n - list every match" << endl;
+    cout << "         o - find related genomes (overlapping k-mers)" << endl;
+    cout << "         x - write all-vs-all similarity matrix" << endl;
+    cout << "         k - classify FASTQ reads           y - benchmark read classification" << endl;
+    cout << "         b - benchmark index kinds          h - benchmark sharded library" << endl;
 }
 
 int main()
@@ -306,12 +930,36 @@ int main()
             case 's':
                 findGenome(library, false);
                 break;
+            case 'i':
+                findSimilarGenome(library);
+                break;
+            case 'n':
+                listAllMatches(library);
+                break;
             case 'r':
                 findRelatedGenomesManual(library);
                 break;
             case 'f':
                 findRelatedGenomesFromFile(library);
                 break;
+            case 'o':
+                findRelatedGenomesByKmers(library);
+                break;
+            case 'x':
+                writeSimilarityMatrix(library);
+                break;
+            case 'b':
+                benchmarkIndexes();
+                break;
+            case 'h':
+                benchmarkShards();
+                break;
+            case 'k':
+                classifyReadsFromFile(library);
+                break;
+            case 'y':
+                benchmarkReadClassification();
+                break;
         }
     }
 }
@@ -4,6 +4,7 @@
 #include <string>
 #include <vector>
 #include <istream>
+#include <functional>
 
 class GenomeImpl;
 
@@ -23,6 +24,25 @@ private:
     GenomeImpl* m_impl;
 };
 
+class GenomeReaderImpl;
+
+  // Reads the Genomes of a FASTA stream one at a time, so that a large file needn't be held
+  // in memory. Genome::load accepts exactly the input GenomeReader does.
+class GenomeReader
+{
+public:
+    GenomeReader(std::istream& genomeSource);
+    ~GenomeReader();
+    bool next(std::string& name, std::string& sequence);
+    bool bad() const;
+      // We prevent a GenomeReader object from being copied or assigned.
+    GenomeReader(const GenomeReader&) = delete;
+    GenomeReader& operator=(const GenomeReader&) = delete;
+
+private:
+    GenomeReaderImpl* m_impl;
+};
+
 struct DNAMatch
 {
     std::string genomeName;
@@ -36,17 +56,92 @@ struct GenomeMatch
     double percentMatch;
 };
 
+  // Called once per enumerated match; return false to stop the enumeration.
+typedef std::function<bool(const DNAMatch&)> DNAMatchCallback;
+
+struct GenomeSimilarity
+{
+    std::string genomeName;
+    double containment;   // percent of the query's k-mer positions found in the genome
+    double jaccard;       // percent of distinct k-mers shared out of both genomes' k-mers
+};
+
+  // Called as work completes with the number of finished and total work units.
+typedef std::function<void(int completed, int total)> ProgressCallback;
+
+  // Trie indexes k-mers of any length; KmerHash keeps k-mers of up to 32 bases as 2 bit
+  // encoded keys in an open addressing table, with the few k-mers containing N set apart.
+  // Both give the same answers.
+enum class IndexKind { Trie, KmerHash };
+
+struct IndexOptions
+{
+    IndexOptions()
+        : skipAmbiguousKmers(false), maxKmerFrequency(0),
+          maskLowComplexity(false), dustWindow(64), dustThreshold(20),
+          filterFalsePositiveRate(0), maxFilterBytesPerGenome(0), resultCacheEntries(0),
+          resultCacheBytes(0), hotPostingBytes(16 << 20) { }
+    bool skipAmbiguousKmers;   // leave k-mers containing N out of the index
+    int maxKmerFrequency;      // stop-list k-mers with more positions than this (0 for no limit)
+    bool maskLowComplexity;    // leave k-mers in low complexity (DUST) regions out of the index
+    int dustWindow;            // window length for the DUST score
+    double dustThreshold;      // windows scoring above this are low complexity
+    double filterFalsePositiveRate;   // of each genome's k-mer filter (0 for no filters)
+    int maxFilterBytesPerGenome;      // size limit of each genome's k-mer filter (0 for no limit)
+    std::string storageDirectory;     // keep sequences and the k-mer hash index's postings in
+                                      // memory-mapped files here instead of memory (empty for
+                                      // memory). a trie index stays in memory. one matcher per
+                                      // directory. addGenome returns false if it can't be written to
+    int resultCacheEntries;           // findGenomesWithThisDNA results to keep (0 for no cache).
+                                      // a result is kept the second time its search misses
+    long long resultCacheBytes;       // memory those results may hold (0 for no limit)
+    long long hotPostingBytes;        // memory for the postings of the most frequent k-mers of a
+                                      // mapped k-mer hash index, kept out of the files (0 for none)
+};
+
+struct ReadAssignment
+{
+    std::string readName;
+    std::string genomeName;   // genome sharing the most k-mers with the read, empty if none
+    int hits;                 // number of the read's k-mers found in that genome
+    bool ambiguous;           // another genome has as many hits
+};
+
+struct QueryStats
+{
+    long long seedsLookedUp;   // seeds searched in the index
+    long long seedsCapped;     // seeds stop-listed, masked, or with an unindexed N
+    long long fallbackSeeds;   // queries seeded at a later offset because earlier seeds were capped
+    long long genomesSkipped;  // genomes findRelatedGenomes left unverified because of their filter
+    long long cacheHits;       // findGenomesWithThisDNA calls answered from the result cache
+    long long cacheMisses;     // findGenomesWithThisDNA calls the result cache didn't have
+};
+
 class GenomeMatcherImpl;
 
 class GenomeMatcher
 {
 public:
-    GenomeMatcher(int minSearchLength);
+    GenomeMatcher(int minSearchLength, IndexKind index = IndexKind::Trie, const IndexOptions& options = IndexOptions());
     ~GenomeMatcher();
-    void addGenome(const Genome& genome);
+    bool addGenome(const Genome& genome);
+      // Seeds starting with a character no k-mer of the library starts with find nothing,
+      // even as SNiPs. ShardedGenomeMatcher shares these characters between its shards so
+      // that each one applies that rule for the whole library.
+    void addFirstBases(const std::string& bases);
+    std::string firstBases() const;
     int minimumSearchLength() const;
+    IndexKind indexKind() const;
+    QueryStats queryStats() const;
+    void resetQueryStats();
     bool findGenomesWithThisDNA(const std::string& fragment, int minimumLength, bool exactMatchOnly, std::vector<DNAMatch>& matches) const;
+    int enumerateDNAMatches(const std::string& fragment, int minimumLength, bool exactMatchOnly, const DNAMatchCallback& callback, int maxMatchesPerGenome = 0) const;
+    bool findGenomesWithSimilarDNA(const std::string& fragment, int minimumLength, int maxEdits, bool allowIndels, std::vector<DNAMatch>& matches) const;
     bool findRelatedGenomes(const Genome& query, int fragmentMatchLength, bool exactMatchOnly, double matchPercentThreshold, std::vector<GenomeMatch>& results) const;
+    bool computeSimilarityMatrix(int fragmentMatchLength, bool exactMatchOnly, const std::string& outputFile, bool sparse, const ProgressCallback& progress = ProgressCallback()) const;
+    bool findRelatedGenomesByKmers(const Genome& query, int fragmentMatchLength, double matchPercentThreshold, std::vector<GenomeSimilarity>& results) const;
+    bool classifyRead(const std::string& read, ReadAssignment& assignment) const;
+    bool classifyReads(const std::string& readsFile, const std::string& outputFile, long long& readsClassified, int numThreads = 0) const;
       // We prevent a GenomeMatcher object from being copied or assigned.
     GenomeMatcher(const GenomeMatcher&) = delete;
     GenomeMatcher& operator=(const GenomeMatcher&) = delete;
@@ -55,4 +150,29 @@ private:
     GenomeMatcherImpl* m_impl;
 };
 
+class ShardedGenomeMatcherImpl;
+
+  // Splits a library by genome name over worker processes, each serving one GenomeMatcher.
+  // Queries go to every shard and the merged results are the ones a single GenomeMatcher
+  // would give, except that maxKmerFrequency is counted within each shard. Queries from
+  // different threads are served at the same time; adding genomes while querying isn't
+  // supported, same as GenomeMatcher.
+class ShardedGenomeMatcher
+{
+public:
+    ShardedGenomeMatcher(int minSearchLength, int numShards, IndexKind index = IndexKind::Trie, const IndexOptions& options = IndexOptions());
+    ~ShardedGenomeMatcher();
+    bool addGenome(const Genome& genome);
+    int minimumSearchLength() const;
+    int numShards() const;
+    bool findGenomesWithThisDNA(const std::string& fragment, int minimumLength, bool exactMatchOnly, std::vector<DNAMatch>& matches) const;
+    bool findRelatedGenomes(const Genome& query, int fragmentMatchLength, bool exactMatchOnly, double matchPercentThreshold, std::vector<GenomeMatch>& results) const;
+      // We prevent a ShardedGenomeMatcher object from being copied or assigned.
+    ShardedGenomeMatcher(const ShardedGenomeMatcher&) = delete;
+    ShardedGenomeMatcher& operator=(const ShardedGenomeMatcher&) = delete;
+
+private:
+    ShardedGenomeMatcherImpl* m_impl;
+};
+
 #endif // PROVIDED_INCLUDED
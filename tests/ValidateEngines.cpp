@@ -0,0 +1,1476 @@
+// Checks every engine of the library against brute-force references and measures the
+// search throughput of each one. Build and run from the repository root:
+//
+//   g++ -std=c++11 -O2 -pthread -I. tests/ValidateEngines.cpp Genome.cpp GenomeMatcher.cpp ShardedGenomeMatcher.cpp -lz -o ValidateEngines
+//   ./ValidateEngines [baseline file]
+//
+// The exit status is 1 if any answer differs from the reference, or if an engine's
+// throughput fell more than 25% below the one recorded in the baseline file. A missing
+// baseline file is recorded from the run.
+
+#include "provided.h"
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+using namespace std;
+
+const string dataDirectories[] = { "data", "../data" };
+
+const string dataFiles[] = {
+    "Ferroplasma_acidarmanus.txt",
+    "Halobacterium_jilantaiense.txt",
+    "Halorubrum_chaoviator.txt"
+};
+
+// Brute-force references. they scan every position of every genome, so they are only fast
+// enough for the small libraries built here. each one is the specification its engines are
+// held to
+
+struct ReferenceGenome
+{
+    string name;
+    string sequence;
+};
+
+// Pre-condition: genome sequence, starting position, fragment, exact match condition
+// Post-condition: returns the number of characters of fragment matching the sequence from the
+//                 position, allowing 1 mismatch if exactMatchOnly is false
+int referenceMatchLength(const string& sequence, size_t position, const string& fragment, bool exactMatchOnly)
+{
+    int mismatches = exactMatchOnly ? 0 : 1;
+    size_t length = 0;
+    while (length < fragment.size() && position + length < sequence.size())
+    {
+        if (sequence[position + length] != fragment[length] && mismatches-- == 0)
+            break;
+        length++;
+    }
+    return static_cast<int>(length);
+}
+
+// Pre-condition: library, minimum search length, and a character
+// Post-condition: returns true if a k-mer of the library starts with the character. a seed
+//                 starting with any other character finds nothing, even as a SNiP, which is
+//                 the root of the trie all engines answer like
+bool referenceFirstBase(const vector<ReferenceGenome>& library, int k, char c)
+{
+    for (const auto& g : library)
+        for (size_t p = 0; p + k <= g.sequence.size(); ++p)
+            if (g.sequence[p] == c)
+                return true;
+    return false;
+}
+
+// Pre-condition: library, minimum search length, and the arguments of findGenomesWithThisDNA
+// Post-condition: store what findGenomesWithThisDNA has to return into matches: the longest
+//                 match per genome, at the lowest position among equally long ones
+bool referenceFindGenomes(const vector<ReferenceGenome>& library, int k, const string& fragment,
+                          int minimumLength, bool exactMatchOnly, vector<DNAMatch>& matches)
+{
+    matches.clear();
+    if (static_cast<int>(fragment.size()) < minimumLength || minimumLength < k)
+        return false;
+    if (!referenceFirstBase(library, k, fragment[0]))
+        return false;
+
+    // a match needs its first k characters indexed, which a match of minimumLength has
+    for (const auto& g : library)
+    {
+        DNAMatch best;
+        best.length = -1;
+        for (size_t p = 0; p + k <= g.sequence.size(); ++p)
+        {
+            int length = referenceMatchLength(g.sequence, p, fragment, exactMatchOnly);
+            if (length > best.length)
+            {
+                best.length = length;
+                best.position = static_cast<int>(p);
+            }
+        }
+        if (best.length >= minimumLength)
+        {
+            best.genomeName = g.name;
+            matches.push_back(best);
+        }
+    }
+    return !matches.empty();
+}
+
+// Pre-condition: library, minimum search length, and the arguments of enumerateDNAMatches
+//                without a limit
+// Post-condition: store every match enumerateDNAMatches has to report into matches
+void referenceEnumerate(const vector<ReferenceGenome>& library, int k, const string& fragment,
+                        int minimumLength, bool exactMatchOnly, vector<DNAMatch>& matches)
+{
+    matches.clear();
+    if (static_cast<int>(fragment.size()) < minimumLength || minimumLength < k)
+        return;
+    if (!referenceFirstBase(library, k, fragment[0]))
+        return;
+    for (const auto& g : library)
+        for (size_t p = 0; p + k <= g.sequence.size(); ++p)
+        {
+            int length = referenceMatchLength(g.sequence, p, fragment, exactMatchOnly);
+            if (length >= minimumLength)
+                matches.push_back(DNAMatch{ g.name, length, static_cast<int>(p) });
+        }
+}
+
+// Pre-condition: genome sequence, starting position, fragment, maximum number of edits, and
+//                indel condition
+// Post-condition: returns the longest prefix of fragment that aligns to the sequence from the
+//                 position with up to maxEdits edits, and stores the fewest edits it takes
+//                 into edits. computed by dynamic programming over the band of maxEdits
+//                 diagonals, stopping once a whole row needs more edits
+int referenceAlignPrefix(const string& sequence, int start, const string& fragment, int maxEdits,
+                         bool allowIndels, int& edits)
+{
+    const int m = static_cast<int>(fragment.size());
+    const int n = static_cast<int>(sequence.size()) - start;
+    if (!allowIndels)
+    {
+        int length = 0;
+        edits = 0;
+        while (length < m && length < n)
+        {
+            if (sequence[start + length] != fragment[length] && edits++ == maxEdits)
+            {
+                edits--;
+                break;
+            }
+            length++;
+        }
+        return length;
+    }
+
+    // row i holds the edits aligning i characters of the fragment to j characters of the
+    // sequence, for j within maxEdits of i, at index j - i + maxEdits
+    const int width = 2 * maxEdits + 1;
+    const int unreachable = INT_MAX / 2;
+    vector<int> previous(width, unreachable), current(width, unreachable);
+    for (int j = 0; j <= min(n, maxEdits); ++j)
+        previous[j + maxEdits] = j;
+    int best = 0;
+    edits = 0;
+    for (int i = 1; i <= m; ++i)
+    {
+        fill(current.begin(), current.end(), unreachable);
+        int rowMinimum = unreachable;
+        for (int index = 0; index < width; ++index)
+        {
+            const int j = i - maxEdits + index;
+            if (j < 0 || j > n)
+                continue;
+            int value = unreachable;
+            if (j == 0)
+                value = i;
+            else
+            {
+                value = previous[index] + (fragment[i - 1] != sequence[start + j - 1] ? 1 : 0);
+                if (index + 1 < width)
+                    value = min(value, previous[index + 1] + 1);
+                if (index > 0)
+                    value = min(value, current[index - 1] + 1);
+            }
+            current[index] = min(value, unreachable);
+            rowMinimum = min(rowMinimum, current[index]);
+        }
+        if (rowMinimum > maxEdits)
+            break;
+        best = i;
+        edits = rowMinimum;
+        previous.swap(current);
+    }
+    return best;
+}
+
+// Pre-condition: library, minimum search length, and the arguments of findGenomesWithSimilarDNA
+// Post-condition: store what findGenomesWithSimilarDNA has to return into matches: the longest
+//                 alignment per genome, with the fewest edits and then at the lowest position
+//                 among equally long ones. nothing is searched when minimum length holds too
+//                 few seeds for the edits
+bool referenceFindSimilar(const vector<ReferenceGenome>& library, int k, const string& fragment,
+                          int minimumLength, int maxEdits, bool allowIndels, vector<DNAMatch>& matches)
+{
+    matches.clear();
+    if (static_cast<int>(fragment.size()) < minimumLength || minimumLength < k || maxEdits < 0)
+        return false;
+    const int seeds = minimumLength / k;
+    if (seeds <= maxEdits && (allowIndels || 2 * seeds <= maxEdits))
+        return false;
+    for (const auto& g : library)
+    {
+        DNAMatch best;
+        best.length = -1;
+        int bestEdits = INT_MAX;
+        for (int p = 0; p < static_cast<int>(g.sequence.size()); ++p)
+        {
+            int edits;
+            int length = referenceAlignPrefix(g.sequence, p, fragment, maxEdits, allowIndels, edits);
+            if (length > best.length || (length == best.length && edits < bestEdits))
+            {
+                best.length = length;
+                best.position = p;
+                bestEdits = edits;
+            }
+        }
+        if (best.length >= minimumLength)
+        {
+            best.genomeName = g.name;
+            matches.push_back(best);
+        }
+    }
+    return !matches.empty();
+}
+
+// Pre-condition: sequence, DUST window length, and score threshold
+// Post-condition: returns for every base whether a window holding it scores above the
+//                 threshold, the score being the pairs of equal base triplets per triplet.
+//                 a sequence shorter than the window is scored as one window
+vector<char> referenceMask(const string& sequence, int window, double threshold)
+{
+    const int n = static_cast<int>(sequence.size());
+    vector<char> masked(n, false);
+    if (window < 4 || n < 4)
+        return masked;
+    const int span = min(window, n);
+    const string bases = "ACGT";
+    for (int start = 0; start + span <= n; ++start)
+    {
+        map<string, int> counts;
+        long long pairs = 0;
+        for (int t = start; t + 3 <= start + span; ++t)
+        {
+            string triplet = sequence.substr(t, 3);
+            if (triplet.find_first_not_of(bases) == string::npos)
+                pairs += counts[triplet]++;
+        }
+        const int triplets = span - 2;
+        if (triplets >= 2 && (double)(pairs) / (triplets - 1) > threshold)
+            fill(masked.begin() + start, masked.begin() + start + span, true);
+    }
+    return masked;
+}
+
+// k-mers a library indexes under some index options: the genome and position of each indexed
+// one, the ones stop-listed because they hold a masked base, and the characters a k-mer that
+// isn't skipped for its N starts with
+struct ReferenceIndex
+{
+    int k;
+    IndexOptions options;
+    unordered_map<string, vector<pair<int, int>>> positions;
+    unordered_set<string> stopListed;
+    string alphabet;
+    string firstBases;
+};
+
+// Pre-condition: library, minimum search length, and index options
+// Post-condition: returns the k-mers the options index, skip, and stop-list for the library
+ReferenceIndex referenceIndex(const vector<ReferenceGenome>& library, int k, const IndexOptions& options)
+{
+    ReferenceIndex index;
+    index.k = k;
+    index.options = options;
+    for (size_t g = 0; g < library.size(); ++g)
+    {
+        const string& sequence = library[g].sequence;
+        vector<char> masked;
+        if (options.maskLowComplexity)
+            masked = referenceMask(sequence, options.dustWindow, options.dustThreshold);
+        for (char c : sequence)
+            if (index.alphabet.find(c) == string::npos)
+                index.alphabet += c;
+        for (size_t p = 0; p + k <= sequence.size(); ++p)
+        {
+            const string kmer = sequence.substr(p, k);
+            if (options.skipAmbiguousKmers && kmer.find_first_not_of("ACGT") != string::npos)
+                continue;
+            if (index.firstBases.find(kmer[0]) == string::npos)
+                index.firstBases += kmer[0];
+            if (!masked.empty() && find(masked.begin() + p, masked.begin() + p + k, true) != masked.begin() + p + k)
+                index.stopListed.insert(kmer);
+            else
+                index.positions[kmer].push_back(make_pair(static_cast<int>(g), static_cast<int>(p)));
+        }
+    }
+    return index;
+}
+
+// Pre-condition: reference index, seed of minimum search length, exact match condition, and
+//                vector to store the result
+// Post-condition: store the genome and position of every indexed k-mer equal to the seed, or
+//                 one character apart for SNiPs, into hits. returns false, with no hits, if
+//                 one of those k-mers is stop-listed or they have more positions than
+//                 maxKmerFrequency
+bool referenceLookupSeed(const ReferenceIndex& index, const string& seed, bool exactMatchOnly,
+                         vector<pair<int, int>>& hits)
+{
+    hits.clear();
+    if (index.firstBases.find(seed[0]) == string::npos)
+        return true;
+    vector<string> keys(1, seed);
+    for (size_t i = 0; !exactMatchOnly && i < seed.size(); ++i)
+        for (char c : index.alphabet)
+            if (c != seed[i])
+            {
+                keys.push_back(seed);
+                keys.back()[i] = c;
+            }
+    for (const auto& key : keys)
+    {
+        if (index.stopListed.count(key) != 0)
+        {
+            hits.clear();
+            return false;
+        }
+        auto it = index.positions.find(key);
+        if (it != index.positions.end())
+            hits.insert(hits.end(), it->second.begin(), it->second.end());
+    }
+    if (index.options.maxKmerFrequency > 0 && static_cast<int>(hits.size()) > index.options.maxKmerFrequency)
+    {
+        hits.clear();
+        return false;
+    }
+    return true;
+}
+
+// Pre-condition: library, its reference index, the arguments of findGenomesWithThisDNA, and
+//                the counters of the searches so far
+// Post-condition: store what findGenomesWithThisDNA has to return under the index options:
+//                 the longest match per genome among the positions of the first seed that
+//                 can be searched and isn't capped, trying seeds at later offsets within
+//                 minimum length, at the lowest position among equally long ones. the seeds
+//                 are counted into stats
+bool referenceFindIndexed(const vector<ReferenceGenome>& library, const ReferenceIndex& index,
+                          const string& fragment, int minimumLength, bool exactMatchOnly,
+                          vector<DNAMatch>& matches, QueryStats& stats)
+{
+    matches.clear();
+    const int k = index.k;
+    if (static_cast<int>(fragment.size()) < minimumLength || minimumLength < k)
+        return false;
+    vector<pair<int, int>> hits;
+    for (int offset = 0; offset + k <= minimumLength; ++offset)
+    {
+        // a seed with more N than the SNiP can take finds nothing once N isn't indexed
+        const string seed = fragment.substr(offset, k);
+        if (index.options.skipAmbiguousKmers &&
+            count_if(seed.begin(), seed.end(), [](char c) { return string("ACGT").find(c) == string::npos; }) >
+            (exactMatchOnly ? 0 : 1))
+        {
+            stats.seedsCapped++;
+            continue;
+        }
+        stats.seedsLookedUp++;
+        if (!referenceLookupSeed(index, seed, exactMatchOnly, hits))
+        {
+            stats.seedsCapped++;
+            continue;
+        }
+        if (offset > 0)
+            stats.fallbackSeeds++;
+        vector<DNAMatch> best(library.size(), DNAMatch{ "", -1, 0 });
+        for (const auto& hit : hits)
+        {
+            const int start = hit.second - offset;
+            if (start < 0)
+                continue;
+            int length = referenceMatchLength(library[hit.first].sequence, start, fragment, exactMatchOnly);
+            DNAMatch& current = best[hit.first];
+            if (current.length < length || (current.length == length && current.position > start))
+            {
+                current.length = length;
+                current.position = start;
+            }
+        }
+        for (size_t g = 0; g < library.size(); ++g)
+            if (best[g].length >= minimumLength)
+                matches.push_back(DNAMatch{ library[g].name, best[g].length, best[g].position });
+        break;
+    }
+    return !matches.empty();
+}
+
+// Pre-condition: library, minimum search length, reference index of the options (null for
+//                none), window of a query, exact match condition, and vector to store result
+// Post-condition: store the genomes matching the whole window into matches
+void referenceFindWindow(const vector<ReferenceGenome>& library, int k, const ReferenceIndex* index,
+                         const string& window, bool exactMatchOnly, vector<DNAMatch>& matches)
+{
+    QueryStats stats = QueryStats();
+    if (index == nullptr)
+        referenceFindGenomes(library, k, window, static_cast<int>(window.size()), exactMatchOnly, matches);
+    else
+        referenceFindIndexed(library, *index, window, static_cast<int>(window.size()), exactMatchOnly, matches, stats);
+}
+
+// Pre-condition: library, minimum search length, the arguments of findRelatedGenomes, and the
+//                reference index of the options, if any
+// Post-condition: store what findRelatedGenomes has to return into results
+bool referenceFindRelated(const vector<ReferenceGenome>& library, int k, const string& query,
+                          int fragmentMatchLength, bool exactMatchOnly, double matchPercentThreshold,
+                          vector<GenomeMatch>& results, const ReferenceIndex* index = nullptr)
+{
+    results.clear();
+    if (fragmentMatchLength < k)
+        return false;
+    const int division = static_cast<int>(query.size()) / fragmentMatchLength;
+    vector<int> counts(library.size(), 0);
+    vector<DNAMatch> matches;
+    for (int w = 0; w < division; ++w)
+    {
+        referenceFindWindow(library, k, index, query.substr(w * fragmentMatchLength, fragmentMatchLength),
+                            exactMatchOnly, matches);
+        for (const auto& m : matches)
+            for (size_t g = 0; g < library.size(); ++g)
+                if (library[g].name == m.genomeName)
+                    counts[g]++;
+    }
+    for (size_t g = 0; g < library.size(); ++g)
+    {
+        double percent = (double)(counts[g]) / division * 100;
+        if (counts[g] > 0 && percent >= matchPercentThreshold)
+            results.push_back(GenomeMatch{ library[g].name, percent });
+    }
+    return !results.empty();
+}
+
+// Pre-condition: library, minimum search length, the arguments of computeSimilarityMatrix, and
+//                the reference index of the options, if any
+// Post-condition: returns the text computeSimilarityMatrix has to write
+string referenceSimilarityMatrix(const vector<ReferenceGenome>& library, int k, int fragmentMatchLength,
+                                 bool exactMatchOnly, bool sparse, const ReferenceIndex* index = nullptr)
+{
+    ostringstream output;
+    output.setf(ios::fixed);
+    output.precision(2);
+    if (!sparse)
+    {
+        for (const auto& g : library)
+            output << '\t' << g.name;
+        output << '\n';
+    }
+    vector<DNAMatch> matches;
+    for (const auto& q : library)
+    {
+        const int division = static_cast<int>(q.sequence.size()) / fragmentMatchLength;
+        vector<int> counts(library.size(), 0);
+        for (int w = 0; w < division; ++w)
+        {
+            referenceFindWindow(library, k, index, q.sequence.substr(w * fragmentMatchLength, fragmentMatchLength),
+                                exactMatchOnly, matches);
+            for (const auto& m : matches)
+                for (size_t g = 0; g < library.size(); ++g)
+                    if (library[g].name == m.genomeName)
+                        counts[g]++;
+        }
+        if (!sparse)
+            output << q.name;
+        for (size_t g = 0; g < library.size(); ++g)
+        {
+            const double percentMatch = division == 0 ? 0 : (double)(counts[g]) / division * 100;
+            if (!sparse)
+                output << '\t' << percentMatch;
+            else if (counts[g] != 0)
+                output << q.name << '\t' << library[g].name << '\t' << percentMatch << '\n';
+        }
+        if (!sparse)
+            output << '\n';
+    }
+    return output.str();
+}
+
+// Pre-condition: k-mer length
+// Post-condition: returns true if every character of the k-mer is a base, so that the k-mer
+//                 has a key
+bool referenceEncodable(const string& kmer)
+{
+    return kmer.find_first_not_of("ACGT") == string::npos;
+}
+
+// Pre-condition: sequence and k-mer length
+// Post-condition: returns every distinct k-mer of the sequence without N
+unordered_set<string> referenceKmers(const string& sequence, int k)
+{
+    unordered_set<string> kmers;
+    for (size_t p = 0; p + k <= sequence.size(); ++p)
+    {
+        string kmer = sequence.substr(p, k);
+        if (referenceEncodable(kmer))
+            kmers.insert(kmer);
+    }
+    return kmers;
+}
+
+// Pre-condition: library, minimum search length, and the arguments of findRelatedGenomesByKmers
+// Post-condition: store what findRelatedGenomesByKmers has to return into results
+bool referenceKmerSimilarity(const vector<ReferenceGenome>& library, int k, const string& query,
+                             int fragmentMatchLength, double matchPercentThreshold,
+                             vector<GenomeSimilarity>& results)
+{
+    results.clear();
+    if (fragmentMatchLength < k || fragmentMatchLength > 32)
+        return false;
+    vector<string> positions;
+    for (size_t p = 0; p + fragmentMatchLength <= query.size(); ++p)
+        if (referenceEncodable(query.substr(p, fragmentMatchLength)))
+            positions.push_back(query.substr(p, fragmentMatchLength));
+    if (positions.empty())
+        return false;
+    const unordered_set<string> distinct(positions.begin(), positions.end());
+    for (const auto& g : library)
+    {
+        const unordered_set<string> kmers = referenceKmers(g.sequence, fragmentMatchLength);
+        int shared = 0;
+        int contained = 0;
+        for (const auto& kmer : distinct)
+            shared += static_cast<int>(kmers.count(kmer));
+        for (const auto& kmer : positions)
+            contained += static_cast<int>(kmers.count(kmer));
+        double containment = (double)(contained) / positions.size() * 100;
+        if (shared == 0 || containment < matchPercentThreshold)
+            continue;
+        GenomeSimilarity similarity;
+        similarity.genomeName  = g.name;
+        similarity.containment = containment;
+        similarity.jaccard     = (double)(shared) / (static_cast<int>(distinct.size()) + static_cast<int>(kmers.size()) - shared) * 100;
+        results.push_back(similarity);
+    }
+    return !results.empty();
+}
+
+// Pre-condition: library, its k-mers of minimum search length per genome, and a read
+// Post-condition: store what classifyRead has to store into assignment and returns what it
+//                 has to return: the genome with the most of the read's k-mer positions, the
+//                 first one added among equals
+bool referenceClassifyRead(const vector<ReferenceGenome>& library, const vector<unordered_set<string>>& kmers,
+                           int k, const string& read, ReadAssignment& assignment)
+{
+    vector<int> hits(library.size(), 0);
+    for (size_t p = 0; p + k <= read.size(); ++p)
+    {
+        string kmer = read.substr(p, k);
+        if (!referenceEncodable(kmer))
+            continue;
+        for (size_t g = 0; g < library.size(); ++g)
+            hits[g] += static_cast<int>(kmers[g].count(kmer));
+    }
+    int best = -1;
+    int bestHits = 0;
+    bool ambiguous = false;
+    for (size_t g = 0; g < library.size(); ++g)
+    {
+        if (hits[g] > bestHits)
+        {
+            best = static_cast<int>(g);
+            bestHits = hits[g];
+            ambiguous = false;
+        }
+        else if (hits[g] > 0 && hits[g] == bestHits)
+            ambiguous = true;
+    }
+    assignment.genomeName = best < 0 ? "" : library[best].name;
+    assignment.hits       = bestHits;
+    assignment.ambiguous  = ambiguous;
+    return best >= 0;
+}
+
+// Pre-condition: random number generator, library, and minimum search length
+// Post-condition: returns a fragment for findGenomesWithThisDNA: a piece of a genome with
+//                 0 to 2 substitutions, an N inside or in front, running off the genome's end,
+//                 or random bases
+string makeValidationFragment(mt19937& rng, const vector<ReferenceGenome>& library, int k)
+{
+    const char bases[] = "ACGT";
+    const ReferenceGenome& g = library[rng() % library.size()];
+    const size_t length = k + rng() % (2 * k + 1);
+    string fragment;
+    const int kind = rng() % 7;
+    if (kind == 4 || g.sequence.size() < length)
+    {
+        for (size_t i = 0; i < length; ++i)
+            fragment += bases[rng() % 4];
+        return fragment;
+    }
+    if (kind == 5)
+    {
+        fragment = g.sequence.substr(g.sequence.size() - length / 2);
+        while (fragment.size() < length)
+            fragment += bases[rng() % 4];
+        return fragment;
+    }
+    fragment = g.sequence.substr(rng() % (g.sequence.size() - length + 1), length);
+    if (kind == 1 || kind == 2)
+        for (int m = 0; m < kind; ++m)
+            fragment[rng() % length] = bases[rng() % 4];
+    if (kind == 3)
+        fragment[rng() % length] = 'N';
+    if (kind == 6)
+        fragment[0] = 'N';
+    return fragment;
+}
+
+// Pre-condition: random number generator, library, minimum search length, and number of edits
+// Post-condition: returns a fragment for findGenomesWithSimilarDNA: a piece of a genome, 1 to
+//                 5 times the minimum search length long, with that many substitutions,
+//                 insertions, and deletions (substitutions only unless indels are allowed),
+//                 or random bases
+string makeSimilarFragment(mt19937& rng, const vector<ReferenceGenome>& library, int k, int edits,
+                           bool allowIndels)
+{
+    const char bases[] = "ACGTN";
+    const ReferenceGenome& g = library[rng() % library.size()];
+    const size_t length = k * (1 + rng() % 5) + rng() % k;
+    string fragment;
+    if (rng() % 6 == 0 || g.sequence.size() < length)
+    {
+        for (size_t i = 0; i < length; ++i)
+            fragment += bases[rng() % 4];
+        return fragment;
+    }
+    fragment = g.sequence.substr(rng() % (g.sequence.size() - length + 1), length);
+    for (int e = 0; e < edits; ++e)
+    {
+        const size_t p = rng() % fragment.size();
+        const int kind = allowIndels ? rng() % 3 : 0;
+        if (kind == 0)
+            fragment[p] = bases[rng() % 5];
+        else if (kind == 1)
+            fragment.insert(fragment.begin() + p, bases[rng() % 4]);
+        else if (fragment.size() > 1)
+            fragment.erase(p, 1);
+    }
+    return fragment;
+}
+
+double secondsSince(chrono::steady_clock::time_point start)
+{
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// Pre-condition: directory path
+// Post-condition: remove the files in the directory and then the directory itself
+void removeDirectory(const string& directory)
+{
+    DIR* dir = opendir(directory.c_str());
+    if (dir != nullptr)
+    {
+        for (dirent* entry = readdir(dir); entry != nullptr; entry = readdir(dir))
+        {
+            string name = entry->d_name;
+            if (name != "." && name != "..")
+                remove((directory + "/" + name).c_str());
+        }
+        closedir(dir);
+    }
+    rmdir(directory.c_str());
+}
+
+// Pre-condition: file path, read names and reads, and whether to compress the file
+// Post-condition: write the reads as FASTQ and returns false if the file can't be written
+bool writeFastq(const string& path, const vector<string>& names, const vector<string>& reads, bool compressed)
+{
+    string text;
+    for (size_t r = 0; r < reads.size(); ++r)
+        text += "@" + names[r] + "\n" + reads[r] + "\n+\n" + string(reads[r].size(), 'I') + "\n";
+    if (!compressed)
+    {
+        ofstream output(path);
+        output << text;
+        return static_cast<bool>(output.flush());
+    }
+    gzFile file = gzopen(path.c_str(), "wb");
+    if (file == nullptr)
+        return false;
+    bool written = gzwrite(file, text.data(), static_cast<unsigned>(text.size())) == static_cast<int>(text.size());
+    return gzclose(file) == Z_OK && written;
+}
+
+// One matcher of each kind the library offers, holding the same genomes
+
+struct ValidationEngine
+{
+    string name;
+    const GenomeMatcher* matcher;            // null for a sharded engine
+    const ShardedGenomeMatcher* sharded;     // null for a single matcher
+
+    bool find(const string& fragment, int minimumLength, bool exactMatchOnly, vector<DNAMatch>& matches) const
+    {
+        return matcher != nullptr ? matcher->findGenomesWithThisDNA(fragment, minimumLength, exactMatchOnly, matches)
+                                  : sharded->findGenomesWithThisDNA(fragment, minimumLength, exactMatchOnly, matches);
+    }
+    bool related(const Genome& query, int fragmentMatchLength, bool exactMatchOnly, double threshold,
+                 vector<GenomeMatch>& results) const
+    {
+        return matcher != nullptr ? matcher->findRelatedGenomes(query, fragmentMatchLength, exactMatchOnly, threshold, results)
+                                  : sharded->findRelatedGenomes(query, fragmentMatchLength, exactMatchOnly, threshold, results);
+    }
+};
+
+IndexOptions cacheOptions(long long bytes)
+{
+    IndexOptions options;
+    options.resultCacheEntries = 4096;
+    options.resultCacheBytes = bytes;
+    return options;
+}
+
+IndexOptions filterOptions()
+{
+    IndexOptions options;
+    options.filterFalsePositiveRate = 0.05;
+    return options;
+}
+
+IndexOptions storageOptions(const string& directory, long long hotBytes)
+{
+    IndexOptions options;
+    options.storageDirectory = directory;
+    options.hotPostingBytes = hotBytes;
+    return options;
+}
+
+IndexOptions cappedOptions()
+{
+    IndexOptions options;
+    options.maxKmerFrequency = 3;
+    return options;
+}
+
+// masks the runs of one or two bases of the repeats genome, which the default threshold
+// only does for the single base run
+IndexOptions maskedOptions()
+{
+    IndexOptions options;
+    options.skipAmbiguousKmers = true;
+    options.maskLowComplexity = true;
+    options.dustThreshold = 10;
+    return options;
+}
+
+struct EngineSet
+{
+    // Pre-condition: minimum search length and an empty directory for the mapped engine, with
+    //                another one at its path plus "-hot"
+    // Post-condition: create every engine with no genomes. one mapped engine reads every
+    //                 posting from its files, the other keeps the most frequent in memory
+    EngineSet(int k, const string& directory)
+        : trie(k, IndexKind::Trie), hash(k, IndexKind::KmerHash),
+          cached(k, IndexKind::KmerHash, cacheOptions(0)), smallCache(k, IndexKind::KmerHash, cacheOptions(16384)),
+          filtered(k, IndexKind::KmerHash, filterOptions()),
+          mapped(k, IndexKind::KmerHash, storageOptions(directory, 0)),
+          mappedHot(k, IndexKind::KmerHash, storageOptions(directory + "-hot", 4096)),
+          shardedTrie(k, 2, IndexKind::Trie), shardedHash(k, 2, IndexKind::KmerHash) { }
+
+    // Pre-condition: genome to add
+    // Post-condition: add the genome to every engine and returns false if any of them fails
+    bool add(const Genome& genome)
+    {
+        bool added = trie.addGenome(genome);
+        added = hash.addGenome(genome) && added;
+        added = cached.addGenome(genome) && added;
+        added = smallCache.addGenome(genome) && added;
+        added = filtered.addGenome(genome) && added;
+        added = mapped.addGenome(genome) && added;
+        added = mappedHot.addGenome(genome) && added;
+        added = shardedTrie.addGenome(genome) && added;
+        added = shardedHash.addGenome(genome) && added;
+        return added;
+    }
+
+    // Post-condition: returns every engine, the single matchers first
+    vector<ValidationEngine> engines() const
+    {
+        return {
+            { "trie", &trie, nullptr },
+            { "k-mer", &hash, nullptr },
+            { "k-mer cached", &cached, nullptr },
+            { "k-mer 16K cache", &smallCache, nullptr },
+            { "k-mer filtered", &filtered, nullptr },
+            { "k-mer mapped", &mapped, nullptr },
+            { "k-mer mapped hot", &mappedHot, nullptr },
+            { "sharded trie", nullptr, &shardedTrie },
+            { "sharded k-mer", nullptr, &shardedHash }
+        };
+    }
+
+    GenomeMatcher trie;
+    GenomeMatcher hash;
+    GenomeMatcher cached;
+    GenomeMatcher smallCache;
+    GenomeMatcher filtered;
+    GenomeMatcher mapped;
+    GenomeMatcher mappedHot;
+    ShardedGenomeMatcher shardedTrie;
+    ShardedGenomeMatcher shardedHash;
+};
+
+bool sameMatches(const vector<DNAMatch>& a, const vector<DNAMatch>& b)
+{
+    if (a.size() != b.size())
+        return false;
+    for (size_t i = 0; i < a.size(); ++i)
+        if (a[i].genomeName != b[i].genomeName || a[i].length != b[i].length || a[i].position != b[i].position)
+            return false;
+    return true;
+}
+
+bool operator<(const DNAMatch& a, const DNAMatch& b)
+{
+    if (a.genomeName != b.genomeName)
+        return a.genomeName < b.genomeName;
+    return a.position < b.position;
+}
+
+int differences = 0;
+long long checks = 0;
+
+// Pre-condition: engine name and what was checked
+// Post-condition: count an answer, and a difference if it wasn't the expected one, printing
+//                 the first few differences
+void check(bool same, const string& engine, const string& what)
+{
+    checks++;
+    if (!same && ++differences <= 10)
+        cout << "  MISMATCH " << engine << ": " << what << endl;
+}
+
+// Pre-condition: random number generator, library, and minimum search length
+// Post-condition: check every engine against the references on the library
+void validateLibrary(mt19937& rng, const vector<ReferenceGenome>& genomes, int k, const string& directory)
+{
+    const char bases[] = "ACGTN";
+    const string where = "k=" + to_string(k) + " ";
+
+    // the library as each engine sees it: genomes shorter than k aren't added
+    vector<ReferenceGenome> library;
+    for (const auto& g : genomes)
+        if (static_cast<int>(g.sequence.size()) >= k)
+            library.push_back(g);
+    EngineSet set(k, directory);
+    for (const auto& g : genomes)
+        check(set.add(Genome(g.name, g.sequence)), "all", where + "adding " + g.name);
+    const vector<ValidationEngine> engines = set.engines();
+
+    // every fragment is searched three times so the cache keeps the result the second time
+    // and answers the third time, or for the smaller cache until it drops it. the exact
+    // answer must never be longer than the SNiP one for the same genome. enumeration has to
+    // report every match the reference has, capped or not
+    vector<DNAMatch> expected, actual, exact, all, reported;
+    long long cacheable = 0;   // searches with lengths the cache is consulted for
+    for (int q = 0; q < 300; ++q)
+    {
+        string fragment = makeValidationFragment(rng, library, k);
+        int minimumLength = k + static_cast<int>(rng() % (fragment.size() - k + 2)) - 1;
+        if (minimumLength >= k)
+            cacheable += 2;
+        for (int exactMatchOnly = 1; exactMatchOnly >= 0; --exactMatchOnly)
+        {
+            const string what = where + "fragment " + fragment + " minimum " + to_string(minimumLength) +
+                                (exactMatchOnly ? " exact" : " SNiP");
+            bool expectedFound = referenceFindGenomes(library, k, fragment, minimumLength, exactMatchOnly == 1, expected);
+            for (const auto& e : engines)
+                for (int repeat = 0; repeat < 3; ++repeat)
+                {
+                    // matches are only meaningful when something was found
+                    bool found = e.find(fragment, minimumLength, exactMatchOnly == 1, actual);
+                    check(found == expectedFound && (!found || sameMatches(expected, actual)), e.name, what);
+                }
+            if (exactMatchOnly)
+                exact = expected;
+
+            if (q % 3 != 0)
+                continue;
+            referenceEnumerate(library, k, fragment, minimumLength, exactMatchOnly == 1, all);
+            sort(all.begin(), all.end());
+            for (const auto& e : engines)
+            {
+                if (e.matcher == nullptr)
+                    continue;
+                for (int cap = 0; cap <= 2; cap += 2)
+                {
+                    reported.clear();
+                    int count = e.matcher->enumerateDNAMatches(fragment, minimumLength, exactMatchOnly == 1,
+                        [&reported](const DNAMatch& m) { reported.push_back(m); return true; }, cap);
+                    sort(reported.begin(), reported.end());
+                    bool same = count == static_cast<int>(reported.size()) &&
+                                adjacent_find(reported.begin(), reported.end(), [](const DNAMatch& a, const DNAMatch& b)
+                                              { return !(a < b) && !(b < a); }) == reported.end();
+                    map<string, int> perGenome, expectedPerGenome;
+                    for (const auto& m : reported)
+                    {
+                        auto it = lower_bound(all.begin(), all.end(), m);
+                        same = same && it != all.end() && it->genomeName == m.genomeName &&
+                               it->position == m.position && it->length == m.length;
+                        perGenome[m.genomeName]++;
+                    }
+                    for (const auto& m : all)
+                        if (cap == 0 || expectedPerGenome[m.genomeName] < cap)
+                            expectedPerGenome[m.genomeName]++;
+                    check(same && perGenome == expectedPerGenome, e.name, what + " enumerated, cap " + to_string(cap));
+                }
+                int count = e.matcher->enumerateDNAMatches(fragment, minimumLength, exactMatchOnly == 1,
+                                                           [](const DNAMatch&) { return false; });
+                check(count == (all.empty() ? 0 : 1), e.name, what + " enumeration stopped by the callback");
+            }
+        }
+        for (const auto& e : exact)
+            for (const auto& s : expected)
+                if (s.genomeName == e.genomeName && s.length < e.length)
+                    check(false, "property", "SNiP match shorter than exact match for " + fragment);
+    }
+    const QueryStats cacheStats = set.cached.queryStats();
+    check(cacheStats.cacheHits == cacheable && cacheStats.cacheMisses == 2 * cacheable, "k-mer cached",
+          where + to_string(cacheStats.cacheHits) + " cache hits and " + to_string(cacheStats.cacheMisses) +
+          " misses for " + to_string(cacheable) + " searches made three times");
+
+    // similar DNA for pieces with edits. a piece of minimum search length with one
+    // substitution, wherever it is, has to be found with one edit allowed
+    for (int q = 0; q < 80; ++q)
+    {
+        const int maxEdits = rng() % 4;
+        const bool allowIndels = rng() % 2 == 0;
+        string fragment;
+        int minimumLength;
+        if (q < 10)
+        {
+            const ReferenceGenome& g = library[rng() % library.size()];
+            fragment = g.sequence.substr(rng() % (g.sequence.size() - k + 1), k);
+            size_t p = q == 0 ? 0 : rng() % fragment.size();
+            fragment[p] = fragment[p] == 'A' ? 'C' : 'A';
+            minimumLength = k;
+            for (int indels = 0; indels <= 1; ++indels)
+            {
+                bool found = referenceFindSimilar(library, k, fragment, minimumLength, 1, indels == 1, expected);
+                check(found == (indels == 0), "reference", where + "similar to " + g.name + " " + fragment);
+                for (const auto& e : engines)
+                    if (e.matcher != nullptr)
+                        check(e.matcher->findGenomesWithSimilarDNA(fragment, minimumLength, 1, indels == 1, actual) ==
+                              found && (!found || sameMatches(expected, actual)), e.name,
+                              where + "similar " + fragment + " minimum " + to_string(minimumLength) + " 1 edit" +
+                              (indels ? " indels" : ""));
+            }
+            continue;
+        }
+        fragment = makeSimilarFragment(rng, library, k, static_cast<int>(rng() % (maxEdits + 2)), allowIndels);
+        if (static_cast<int>(fragment.size()) < k)
+            continue;
+        minimumLength = k + static_cast<int>(rng() % (fragment.size() - k + 1));
+        bool expectedFound = referenceFindSimilar(library, k, fragment, minimumLength, maxEdits, allowIndels, expected);
+        for (const auto& e : engines)
+        {
+            if (e.matcher == nullptr)
+                continue;
+            bool found = e.matcher->findGenomesWithSimilarDNA(fragment, minimumLength, maxEdits, allowIndels, actual);
+            check(found == expectedFound && (!found || sameMatches(expected, actual)), e.name,
+                  where + "similar " + fragment + " minimum " + to_string(minimumLength) + " " +
+                  to_string(maxEdits) + " edits" + (allowIndels ? " indels" : ""));
+        }
+    }
+
+    // related genomes for a mutated piece of each genome long enough to hold windows, by
+    // matching windows and by shared k-mers
+    for (const auto& g : library)
+    {
+        if (g.sequence.size() < 1000)
+            continue;
+        string query = g.sequence.substr(g.sequence.size() / 4, 1000);
+        for (int m = 0; m < 10; ++m)
+            query[rng() % query.size()] = bases[rng() % 5];
+        const Genome queryGenome("query", query);
+        bool exactMatchOnly = rng() % 2 == 0;
+        double threshold = rng() % 3 * 10;
+        vector<GenomeMatch> expectedResults, actualResults;
+        bool expectedFound = referenceFindRelated(library, k, query, 2 * k, exactMatchOnly, threshold, expectedResults);
+        for (const auto& e : engines)
+        {
+            bool found = e.related(queryGenome, 2 * k, exactMatchOnly, threshold, actualResults);
+            bool same = found == expectedFound && (!found || expectedResults.size() == actualResults.size());
+            for (size_t i = 0; same && found && i < expectedResults.size(); ++i)
+                same = expectedResults[i].genomeName == actualResults[i].genomeName &&
+                       expectedResults[i].percentMatch == actualResults[i].percentMatch;
+            check(same, e.name, where + "related genomes of a piece of " + g.name);
+        }
+
+        const int kmerLengths[] = { k, k + 5, k - 1 };
+        for (int length : kmerLengths)
+        {
+            vector<GenomeSimilarity> expectedSimilar, actualSimilar;
+            expectedFound = referenceKmerSimilarity(library, k, query, length, threshold, expectedSimilar);
+            for (const auto& e : engines)
+            {
+                if (e.matcher == nullptr)
+                    continue;
+                bool found = e.matcher->findRelatedGenomesByKmers(queryGenome, length, threshold, actualSimilar);
+                bool same = found == expectedFound && (!found || expectedSimilar.size() == actualSimilar.size());
+                for (size_t i = 0; same && found && i < expectedSimilar.size(); ++i)
+                    same = expectedSimilar[i].genomeName == actualSimilar[i].genomeName &&
+                           expectedSimilar[i].containment == actualSimilar[i].containment &&
+                           expectedSimilar[i].jaccard == actualSimilar[i].jaccard;
+                check(same, e.name, where + to_string(length) + "-mer similarity of a piece of " + g.name);
+            }
+        }
+    }
+
+    // the similarity matrix, dense and sparse, read back from the file
+    const thread::id caller = this_thread::get_id();
+    const string matrixFile = directory + "-matrix.tsv";
+    for (int sparse = 0; sparse <= 1; ++sparse)
+    {
+        const int fragmentMatchLength = max(2 * k, 100);
+        const bool exactMatchOnly = sparse == 1;
+        const string expectedText = referenceSimilarityMatrix(library, k, fragmentMatchLength, exactMatchOnly, sparse == 1);
+        for (const auto& e : engines)
+        {
+            if (e.matcher == nullptr)
+                continue;
+            // progress counts the blocks up one at a time on the calling thread
+            vector<int> completed;
+            bool inOrder = true;
+            bool written = e.matcher->computeSimilarityMatrix(fragmentMatchLength, exactMatchOnly, matrixFile, sparse == 1,
+                [&](int done, int total) {
+                    inOrder = inOrder && this_thread::get_id() == caller && done == static_cast<int>(completed.size()) + 1 &&
+                              done <= total && (completed.empty() || total == completed.front());
+                    completed.push_back(total);
+                });
+            ifstream input(matrixFile);
+            ostringstream text;
+            text << input.rdbuf();
+            check(written && text.str() == expectedText, e.name,
+                  where + (sparse ? "sparse" : "dense") + " similarity matrix");
+            check(inOrder && !completed.empty() && static_cast<int>(completed.size()) == completed.front(), e.name,
+                  where + "similarity matrix progress");
+        }
+        check(!set.trie.computeSimilarityMatrix(k - 1, exactMatchOnly, matrixFile, sparse == 1), "trie",
+              where + "similarity matrix of windows shorter than k");
+    }
+    remove(matrixFile.c_str());
+
+    // reads one at a time and from FASTQ files, plain and compressed, on several threads
+    vector<unordered_set<string>> kmers;
+    for (const auto& g : library)
+        kmers.push_back(referenceKmers(g.sequence, k));
+    vector<string> names, reads;
+    string expectedOutput;
+    for (int r = 0; r < 300; ++r)
+    {
+        string read = makeValidationFragment(rng, library, k);
+        while (read.size() < 100)
+            read += makeValidationFragment(rng, library, k);
+        ReadAssignment expectedAssignment, actualAssignment;
+        bool expectedFound = referenceClassifyRead(library, kmers, k, read, expectedAssignment);
+        for (const auto& e : engines)
+        {
+            if (e.matcher == nullptr)
+                continue;
+            bool found = e.matcher->classifyRead(read, actualAssignment);
+            check(found == expectedFound && actualAssignment.genomeName == expectedAssignment.genomeName &&
+                  actualAssignment.hits == expectedAssignment.hits &&
+                  actualAssignment.ambiguous == expectedAssignment.ambiguous, e.name, where + "classify read " + read);
+        }
+        names.push_back("read" + to_string(r));
+        reads.push_back(read);
+        expectedOutput += names.back() + "\t" + (expectedFound ? expectedAssignment.genomeName : "*") + "\t" +
+                          to_string(expectedAssignment.hits) + (expectedAssignment.ambiguous ? "\t1\n" : "\t0\n");
+    }
+    const string readsFile = directory + "-reads.fq";
+    const string assignmentsFile = directory + "-assignments.tsv";
+    for (int compressed = 0; compressed <= 1; ++compressed)
+    {
+        if (!writeFastq(readsFile, names, reads, compressed == 1))
+        {
+            check(false, "harness", "cannot write " + readsFile);
+            break;
+        }
+        for (const auto& e : engines)
+        {
+            if (e.matcher == nullptr)
+                continue;
+            long long classified = 0;
+            bool done = e.matcher->classifyReads(readsFile, assignmentsFile, classified, 3);
+            ifstream input(assignmentsFile);
+            ostringstream text;
+            text << input.rdbuf();
+            check(done && classified == static_cast<long long>(reads.size()) && text.str() == expectedOutput, e.name,
+                  where + "classify " + (compressed ? "compressed" : "plain") + " FASTQ file");
+        }
+    }
+    remove(readsFile.c_str());
+    remove(assignmentsFile.c_str());
+
+    cout << "  k=" << setw(2) << k << ": " << library.size() << " genomes checked" << endl;
+}
+
+// Pre-condition: random number generator, library, minimum search length, and path prefix for
+//                the files written
+// Post-condition: check trie and k-mer engines under index options that leave k-mers out:
+//                 stop-listed over a frequency, and with N skipped and low complexity masked.
+//                 searches, their seed counters, related genomes, and the similarity matrix
+//                 are checked against the reference index of the options, and enumeration,
+//                 similar DNA, and read classification against the other engine
+void validateIndexOptions(mt19937& rng, const vector<ReferenceGenome>& genomes, int k, const string& directory)
+{
+    const char bases[] = "ACGTN";
+    vector<ReferenceGenome> library;
+    for (const auto& g : genomes)
+        if (static_cast<int>(g.sequence.size()) >= k)
+            library.push_back(g);
+    const pair<string, IndexOptions> optionSets[] = {
+        { "capped", cappedOptions() },
+        { "masked", maskedOptions() }
+    };
+    for (const auto& options : optionSets)
+    {
+        const string where = "k=" + to_string(k) + " ";
+        const ReferenceIndex index = referenceIndex(library, k, options.second);
+        GenomeMatcher trie(k, IndexKind::Trie, options.second);
+        GenomeMatcher hash(k, IndexKind::KmerHash, options.second);
+        for (const auto& g : genomes)
+            check(trie.addGenome(Genome(g.name, g.sequence)) && hash.addGenome(Genome(g.name, g.sequence)),
+                  "all", where + "adding " + g.name);
+        const vector<pair<string, const GenomeMatcher*>> engines = {
+            { options.first + " trie", &trie },
+            { options.first + " k-mer", &hash }
+        };
+
+        // searches count the same seeds as the reference takes, falling back past capped ones
+        QueryStats expectedStats = QueryStats();
+        vector<DNAMatch> expected, actual, reported;
+        vector<string> fragments;
+        vector<int> minimumLengths;
+        for (int q = 0; q < 300; ++q)
+        {
+            fragments.push_back(makeValidationFragment(rng, library, k));
+            minimumLengths.push_back(k + static_cast<int>(rng() % (fragments.back().size() - k + 1)));
+            for (int exactMatchOnly = 1; exactMatchOnly >= 0; --exactMatchOnly)
+            {
+                bool expectedFound = referenceFindIndexed(library, index, fragments[q], minimumLengths[q],
+                                                          exactMatchOnly == 1, expected, expectedStats);
+                for (const auto& e : engines)
+                {
+                    bool found = e.second->findGenomesWithThisDNA(fragments[q], minimumLengths[q], exactMatchOnly == 1, actual);
+                    check(found == expectedFound && (!found || sameMatches(expected, actual)), e.first,
+                          where + "fragment " + fragments[q] + " minimum " + to_string(minimumLengths[q]) +
+                          (exactMatchOnly ? " exact" : " SNiP"));
+                }
+            }
+        }
+        for (const auto& e : engines)
+        {
+            const QueryStats stats = e.second->queryStats();
+            check(stats.seedsLookedUp == expectedStats.seedsLookedUp && stats.seedsCapped == expectedStats.seedsCapped &&
+                  stats.fallbackSeeds == expectedStats.fallbackSeeds, e.first,
+                  where + to_string(stats.seedsLookedUp) + " seeds looked up, " + to_string(stats.seedsCapped) +
+                  " capped, and " + to_string(stats.fallbackSeeds) + " fallbacks instead of " +
+                  to_string(expectedStats.seedsLookedUp) + ", " + to_string(expectedStats.seedsCapped) + ", and " +
+                  to_string(expectedStats.fallbackSeeds));
+        }
+
+        // enumeration seeds like the search, so both engines report the same matches
+        for (size_t q = 0; q < fragments.size(); q += 3)
+            for (int exactMatchOnly = 1; exactMatchOnly >= 0; --exactMatchOnly)
+            {
+                vector<DNAMatch> first;
+                for (size_t e = 0; e < engines.size(); ++e)
+                {
+                    reported.clear();
+                    int count = engines[e].second->enumerateDNAMatches(fragments[q], minimumLengths[q], exactMatchOnly == 1,
+                        [&reported](const DNAMatch& m) { reported.push_back(m); return true; });
+                    sort(reported.begin(), reported.end());
+                    if (e == 0)
+                        first = reported;
+                    else
+                        check(count == static_cast<int>(reported.size()) && sameMatches(first, reported), engines[e].first,
+                              where + "fragment " + fragments[q] + " enumerated like " + engines[0].first);
+                }
+            }
+
+        // similar DNA and read classification
+        for (int q = 0; q < 60; ++q)
+        {
+            const int maxEdits = rng() % 4;
+            const bool allowIndels = rng() % 2 == 0;
+            string fragment = makeSimilarFragment(rng, library, k, static_cast<int>(rng() % (maxEdits + 2)), allowIndels);
+            if (static_cast<int>(fragment.size()) < k)
+                continue;
+            const int minimumLength = k + static_cast<int>(rng() % (fragment.size() - k + 1));
+            bool expectedFound = trie.findGenomesWithSimilarDNA(fragment, minimumLength, maxEdits, allowIndels, expected);
+            bool found = hash.findGenomesWithSimilarDNA(fragment, minimumLength, maxEdits, allowIndels, actual);
+            check(found == expectedFound && (!found || sameMatches(expected, actual)), engines[1].first,
+                  where + "similar " + fragment + " minimum " + to_string(minimumLength) + " " +
+                  to_string(maxEdits) + " edits" + (allowIndels ? " indels" : "") + " like " + engines[0].first);
+        }
+        for (int r = 0; r < 100; ++r)
+        {
+            string read = makeValidationFragment(rng, library, k);
+            while (read.size() < 100)
+                read += makeValidationFragment(rng, library, k);
+            ReadAssignment expectedAssignment, actualAssignment;
+            bool expectedFound = trie.classifyRead(read, expectedAssignment);
+            bool found = hash.classifyRead(read, actualAssignment);
+            check(found == expectedFound && actualAssignment.genomeName == expectedAssignment.genomeName &&
+                  actualAssignment.hits == expectedAssignment.hits &&
+                  actualAssignment.ambiguous == expectedAssignment.ambiguous, engines[1].first,
+                  where + "classify read " + read + " like " + engines[0].first);
+        }
+
+        // related genomes of a mutated piece of each genome, and the similarity matrix
+        for (const auto& g : library)
+        {
+            if (g.sequence.size() < 1000)
+                continue;
+            string query = g.sequence.substr(g.sequence.size() / 4, 1000);
+            for (int m = 0; m < 10; ++m)
+                query[rng() % query.size()] = bases[rng() % 5];
+            const bool exactMatchOnly = rng() % 2 == 0;
+            const double threshold = rng() % 3 * 10;
+            vector<GenomeMatch> expectedResults, actualResults;
+            bool expectedFound = referenceFindRelated(library, k, query, 2 * k, exactMatchOnly, threshold,
+                                                      expectedResults, &index);
+            for (const auto& e : engines)
+            {
+                bool found = e.second->findRelatedGenomes(Genome("query", query), 2 * k, exactMatchOnly, threshold,
+                                                          actualResults);
+                bool same = found == expectedFound && (!found || expectedResults.size() == actualResults.size());
+                for (size_t i = 0; same && found && i < expectedResults.size(); ++i)
+                    same = expectedResults[i].genomeName == actualResults[i].genomeName &&
+                           expectedResults[i].percentMatch == actualResults[i].percentMatch;
+                check(same, e.first, where + "related genomes of a piece of " + g.name);
+            }
+        }
+        const string matrixFile = directory + "-" + options.first + "-matrix.tsv";
+        for (int sparse = 0; sparse <= 1; ++sparse)
+        {
+            const int fragmentMatchLength = max(2 * k, 100);
+            const bool exactMatchOnly = sparse == 0;
+            const string expectedText = referenceSimilarityMatrix(library, k, fragmentMatchLength, exactMatchOnly,
+                                                                  sparse == 1, &index);
+            for (const auto& e : engines)
+            {
+                bool written = e.second->computeSimilarityMatrix(fragmentMatchLength, exactMatchOnly, matrixFile, sparse == 1);
+                ifstream input(matrixFile);
+                ostringstream text;
+                text << input.rdbuf();
+                check(written && text.str() == expectedText, e.first,
+                      where + (sparse ? "sparse" : "dense") + " similarity matrix");
+            }
+        }
+        remove(matrixFile.c_str());
+    }
+    cout << "  k=" << setw(2) << k << ": capped and masked indexes checked" << endl;
+}
+
+// Pre-condition: random number generator, library, directory for the mapped engine, and file to
+//                compare throughput with and record it into (empty for none)
+// Post-condition: print each engine's findGenomesWithThisDNA throughput, the median of several
+//                 runs of at least a fixed time over fragments a cache can't keep, and for the
+//                 cached engine over fragments it has kept. returns false if any fell more than
+//                 the tolerance below the baseline file
+bool measureThroughput(mt19937& rng, const vector<ReferenceGenome>& genomes, const string& directory,
+                       const string& baselineFile)
+{
+    const int k = 12;
+    const int runs = 7;
+    const double secondsPerRun = 0.2;
+    const size_t coldFragments = 20000;   // many more than the caches keep
+    const size_t hitFragments = 2000;     // fewer than the cached engine keeps
+    vector<ReferenceGenome> library;
+    for (const auto& g : genomes)
+        if (static_cast<int>(g.sequence.size()) >= k)
+            library.push_back(g);
+    EngineSet set(k, directory);
+    for (const auto& g : genomes)
+        set.add(Genome(g.name, g.sequence));
+    vector<string> fragments;
+    vector<int> minimumLengths;
+    for (size_t q = 0; q < coldFragments + hitFragments; ++q)
+    {
+        fragments.push_back(makeValidationFragment(rng, library, k));
+        minimumLengths.push_back(k + static_cast<int>(rng() % (fragments.back().size() - k + 1)));
+    }
+
+    // a timing goes on through its fragments from where its last run stopped, cycling through
+    // them, until the run has taken long enough. the cold ones cycle through so many that a
+    // cache drops each before it comes around again
+    struct Timing
+    {
+        string name;
+        ValidationEngine engine;
+        size_t first;
+        size_t count;
+        size_t next;
+        vector<double> rates;
+    };
+    vector<Timing> timings;
+    vector<DNAMatch> matches;
+    for (const auto& e : set.engines())
+    {
+        timings.push_back(Timing{ e.name, e, 0, coldFragments, 0, {} });
+        if (e.matcher == &set.cached)
+            timings.push_back(Timing{ e.name + " hits", e, coldFragments, hitFragments, 0, {} });
+    }
+    auto search = [&](Timing& t)
+    {
+        const size_t q = t.first + t.next;
+        t.engine.find(fragments[q], minimumLengths[q], q % 2 == 0, matches);
+        t.next = (t.next + 1) % t.count;
+    };
+
+    // the first searches build the indexes and fill the cache, and aren't timed. runs of the
+    // engines take turns so that a slow spell of the machine doesn't fall on one engine only
+    for (auto& t : timings)
+        for (size_t q = 0; q < min(t.count, hitFragments) * 2; ++q)
+            search(t);
+    for (int r = 0; r < runs; ++r)
+        for (auto& t : timings)
+        {
+            long long searches = 0;
+            auto start = chrono::steady_clock::now();
+            double seconds = 0;
+            while (seconds < secondsPerRun)
+            {
+                for (int q = 0; q < 64; ++q)
+                    search(t);
+                searches += 64;
+                seconds = secondsSince(start);
+            }
+            t.rates.push_back(searches / seconds);
+        }
+
+    // against the baseline file when it has one. a missing baseline is recorded from this run
+    const double tolerance = 0.25;
+    map<string, double> baseline;
+    ifstream baselineInput(baselineFile);
+    string line;
+    while (baselineInput && getline(baselineInput, line))
+    {
+        size_t tab = line.find('\t');
+        if (tab != string::npos)
+            baseline[line.substr(0, tab)] = atof(line.c_str() + tab + 1);
+    }
+    bool fast = true;
+    map<string, double> medians;
+    cout.setf(ios::fixed);
+    cout << "  engine              searches/s  baseline   (median of " << runs << " runs of at least "
+         << static_cast<int>(secondsPerRun * 1000) << " ms)" << endl;
+    for (auto& t : timings)
+    {
+        const string& name = t.name;
+        sort(t.rates.begin(), t.rates.end());
+        medians[name] = t.rates[t.rates.size() / 2];
+        cout << "  " << left << setw(18) << name << right << setprecision(0) << setw(12) << medians[name];
+        auto it = baseline.find(name);
+        if (it != baseline.end())
+        {
+            cout << setw(10) << it->second;
+            if (medians[name] < it->second * (1 - tolerance))
+            {
+                cout << "  SLOWER";
+                fast = false;
+            }
+        }
+        cout << endl;
+    }
+    if (!baselineFile.empty() && baseline.empty())
+    {
+        ofstream baselineOutput(baselineFile);
+        for (const auto& t : timings)
+            baselineOutput << t.name << '\t' << medians[t.name] << '\n';
+        cout << "  throughput recorded to " << baselineFile << endl;
+    }
+    return fast;
+}
+
+int main(int argc, char* argv[])
+{
+    // up to 6000 bases of the first genome of a few data files, plus a mutated copy of
+    // random bases, one with runs of N, low complexity repeats, and a genome too short to be
+    // indexed for most lengths
+    const char bases[] = "ACGT";
+    mt19937 rng(39);
+    vector<ReferenceGenome> genomes;
+    for (const auto& file : dataFiles)
+    {
+        ifstream input;
+        for (const auto& dataDirectory : dataDirectories)
+            if (!input.is_open())
+                input.open(dataDirectory + "/" + file);
+        vector<Genome> loaded;
+        string sequence;
+        if (!input || !Genome::load(input, loaded) ||
+            !loaded[0].extract(0, min(loaded[0].length(), 6000), sequence))
+            continue;
+        genomes.push_back(ReferenceGenome{ loaded[0].name(), sequence });
+    }
+    if (genomes.empty())
+        cout << "(data files not found, using synthetic genomes only)" << endl;
+    string random;
+    for (int i = 0; i < 6000; ++i)
+        random += bases[rng() % 4];
+    string mutant = random;
+    for (int i = 0; i < 60; ++i)
+        mutant[rng() % mutant.size()] = bases[rng() % 4];
+    string ambiguous = random.substr(1000, 3000);
+    for (int i = 0; i < 40; ++i)
+        ambiguous[rng() % ambiguous.size()] = 'N';
+    ambiguous.replace(1500, 50, string(50, 'N'));
+    string repeats;
+    for (int i = 0; i < 400; ++i)
+        repeats += "AC";
+    repeats += random.substr(0, 500) + string(300, 'A') + random.substr(3000, 500);
+    genomes.push_back(ReferenceGenome{ "random", random });
+    genomes.push_back(ReferenceGenome{ "mutant of random", mutant });
+    genomes.push_back(ReferenceGenome{ "ambiguous", ambiguous });
+    genomes.push_back(ReferenceGenome{ "repeats", repeats });
+    genomes.push_back(ReferenceGenome{ "short", "GATTACA" });
+
+    // the mapped engines keep their files in a directory of their own per library
+    char temporary[] = "/tmp/ValidateEngines.XXXXXX";
+    if (mkdtemp(temporary) == nullptr)
+    {
+        cout << "Cannot create a temporary directory." << endl;
+        return 1;
+    }
+    const int kValues[] = { 6, 10, 12, 21, 31 };
+    for (int k : kValues)
+    {
+        const string directory = string(temporary) + "/k" + to_string(k);
+        mkdir(directory.c_str(), 0700);
+        mkdir((directory + "-hot").c_str(), 0700);
+        validateLibrary(rng, genomes, k, directory);
+        validateIndexOptions(rng, genomes, k, directory);
+        removeDirectory(directory);
+        removeDirectory(directory + "-hot");
+    }
+    const string directory = string(temporary) + "/throughput";
+    mkdir(directory.c_str(), 0700);
+    mkdir((directory + "-hot").c_str(), 0700);
+    bool fast = measureThroughput(rng, genomes, directory, argc > 1 ? argv[1] : "");
+    removeDirectory(directory);
+    removeDirectory(directory + "-hot");
+    rmdir(temporary);
+
+    cout << "  " << checks << " answers checked, " << differences << " differed from the reference" << endl;
+    bool passed = differences == 0 && fast;
+    cout << (passed ? "PASSED" : "FAILED") << endl;
+    return passed ? 0 : 1;
+}